@@ -66,3 +66,11 @@ vector<const char*> convertToVectorOfPointers(const vector<string>& vec){
     }
     return result;
 }
+
+
+bool extensionEnabled(const vector<const char*>& extensions, const char* name){
+    for (const char* extension : extensions){
+        if (!strcmp(extension, name)) return true;
+    }
+    return false;
+}
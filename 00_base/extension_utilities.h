@@ -45,5 +45,8 @@ public:
 //return a vector of pointers to first characters of strings
 vector<const char*> convertToVectorOfPointers(const vector<string>& vec);
 
+//return true if the extension with given name is in the list of enabled extensions
+bool extensionEnabled(const vector<const char*>& extensions, const char* name);
+
 
 #endif // EXTENSION_UTILITIES_H
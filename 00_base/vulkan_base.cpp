@@ -1,11 +1,21 @@
 #include "vulkan_base.h"
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
 
 #include "extension_utilities.h"
 
+#ifdef _WIN32
 //console handle, used for colored output
 HANDLE hConsole;
+#else
+//true if standard output is a terminal, used for colored output
+bool ansiConsole = false;
+#endif
 
 #define EXPORTED_VULKAN_FUNCTION( name ) PFN_##name name;
 #define GLOBAL_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
@@ -17,14 +27,39 @@ HANDLE hConsole;
 #include "vulkan_function_list.inl"
 
 
+LibraryHandle loadVulkanLibrary(){
+#ifdef _WIN32
+    return LoadLibrary("vulkan-1.dll");
+#else
+    //RTLD_LOCAL - loader symbols aren't visible to other libraries, functions are loaded through vkGetInstanceProcAddr only
+    return dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+void freeVulkanLibrary(LibraryHandle vulkan_library){
+#ifdef _WIN32
+    FreeLibrary(vulkan_library);
+#else
+    dlclose(vulkan_library);
+#endif
+}
+
+
 //Load global vulkan functions from library
-int loadVulkanFunctions(HMODULE& vulkan_library){
+int loadVulkanFunctions(LibraryHandle& vulkan_library){
+#ifdef _WIN32
     //load handle to console
     hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    //get address of an exported function from the library
+    #define LOAD_EXPORTED_FUNCTION( name ) (void*) GetProcAddress( vulkan_library, #name )
+#else
+    //print colors only if output isn't redirected to a file, e.g. in CI logs
+    ansiConsole = isatty(STDOUT_FILENO);
+    #define LOAD_EXPORTED_FUNCTION( name ) dlsym( vulkan_library, #name )
+#endif
 
     //define macros to automatically load all global functions
 #define EXPORTED_VULKAN_FUNCTION( name )                                                    \
-    name = reinterpret_cast<PFN_##name>((void*) GetProcAddress( vulkan_library, #name ));   \
+    name = reinterpret_cast<PFN_##name>(LOAD_EXPORTED_FUNCTION( name ));                    \
     DEBUG_CHECK_INV("Could not load exported Vulkan function named: "#name, name)
 
 #define GLOBAL_LEVEL_VULKAN_FUNCTION( name )                        \
@@ -33,6 +68,7 @@ int loadVulkanFunctions(HMODULE& vulkan_library){
 
     //by including function list with the macros specified above, this function will load all global vulkan functions
     #include "vulkan_function_list.inl"
+#undef LOAD_EXPORTED_FUNCTION
     return 0;
 }
 
@@ -12,14 +12,21 @@
 #ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.h>
+//handle of the loaded vulkan-1.dll
+typedef HMODULE LibraryHandle;
+#elif defined __linux__
+#include <vulkan/vulkan.h>
+//handle of the loaded libvulkan.so.1, returned by dlopen
+typedef void* LibraryHandle;
 #else
-#error Currently, compilation works only on Windows because of how the library is loaded. Theoretically, all classes and functions except class VulkanLibrary and func loadVulkanFunctions() should be platform-agnostic. It should be relatively easy to convert both functions to their linux/mac versions if needed.
+#error Currently, compilation works only on Windows and Linux because of how the library is loaded. Only loadVulkanLibrary(), freeVulkanLibrary() and loadVulkanFunctions() in vulkan_base.cpp are platform-specific, it should be relatively easy to add mac versions if needed.
 #endif 
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <cstring>
 
 
 using std::vector;
@@ -41,26 +48,39 @@ constexpr uint32_t VULKAN_VERSION = VK_MAKE_VERSION(1, 2, 154);
 //include list of functions to forward declare all of them
 #include "vulkan_function_list.inl"
 
+//Load the vulkan loader library - vulkan-1.dll on windows, libvulkan.so.1 on linux. Returns nullptr if it couldn't be loaded
+LibraryHandle loadVulkanLibrary();
+//Unload the vulkan loader library
+void freeVulkanLibrary(LibraryHandle vulkan_library);
 //Load all global vulkan functions (Set their previously declared pointers)
-int loadVulkanFunctions(HMODULE& vulkan_library);
+int loadVulkanFunctions(LibraryHandle& vulkan_library);
 //Load all instance level vulkan functions (Set their previously declared pointers)
 int loadInstanceLevelFunctions(VkInstance& instance, const vector<const char*>& extensions);
 //Load all device level functions (Set their previously declared pointers)
 int loadDeviceLevelFunctions(VkDevice& device, const vector<const char*>& extensions);
 
+//where to output all debug results
+#define DEBUG_OUT std::cout
+
+#ifdef _WIN32
 //handle to windows console to enable colored output
 extern HANDLE hConsole;
+//set console text color - windows console attribute is used on windows, ANSI color code elsewhere
+#define CONSOLE_COLOR(windows_color, ansi_color) SetConsoleTextAttribute(hConsole, windows_color);
+#else
+//whether output is a terminal, colors are left out otherwise, so that logs stay readable
+extern bool ansiConsole;
+#define CONSOLE_COLOR(windows_color, ansi_color) if (ansiConsole) DEBUG_OUT << "\033[" ansi_color "m";
+#endif
 
-//where to output all debug results
-#define DEBUG_OUT std::cout
 //print green text
-#define PRINT_SUCCESS(text) {SetConsoleTextAttribute(hConsole, 2); DEBUG_OUT << text << ".\n"; SetConsoleTextAttribute(hConsole, 15);}
+#define PRINT_SUCCESS(text) {CONSOLE_COLOR(2, "32") DEBUG_OUT << text << ".\n"; CONSOLE_COLOR(15, "0")}
 //print yellow text
-#define PRINT_WARN(text) {SetConsoleTextAttribute(hConsole, 14); DEBUG_OUT << text << ".\n"; SetConsoleTextAttribute(hConsole, 15);}
+#define PRINT_WARN(text) {CONSOLE_COLOR(14, "93") DEBUG_OUT << text << ".\n"; CONSOLE_COLOR(15, "0")}
 //print cyan? text with file and line
-#define PRINT_DEBUG(text) {SetConsoleTextAttribute(hConsole, 11); DEBUG_OUT << __FILE__ << ":" << __LINE__ << " : " << text << ".\n"; SetConsoleTextAttribute(hConsole, 15);}
+#define PRINT_DEBUG(text) {CONSOLE_COLOR(11, "96") DEBUG_OUT << __FILE__ << ":" << __LINE__ << " : " << text << ".\n"; CONSOLE_COLOR(15, "0")}
 //print red text with relative path to file and line where error happened
-#define PRINT_ERROR(text) {SetConsoleTextAttribute(hConsole, 4); DEBUG_OUT << __FILE__ << ":" << __LINE__ << " : " << text << ".\n"; SetConsoleTextAttribute(hConsole, 15);}
+#define PRINT_ERROR(text) {CONSOLE_COLOR(4, "31") DEBUG_OUT << __FILE__ << ":" << __LINE__ << " : " << text << ".\n"; CONSOLE_COLOR(15, "0")}
 //if (result != 0), print error with name and location of occurence
 #define DEBUG_CHECK(name, result) if (result) {PRINT_ERROR(name << " failed. Code: " << result); throw std::runtime_error(name);}
 //if (result == 0), print error with name and location of occurence
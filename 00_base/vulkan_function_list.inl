@@ -1,5 +1,3 @@
-#define VK_USE_PLATFORM_WIN32_KHR
-
 /**
  * vulkan_function_list.inl
  *  - List of all vulkan functions to be used
@@ -38,6 +36,7 @@ INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceProperties )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceFeatures )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceFormatProperties )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceMemoryProperties )
+INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceMemoryProperties2 )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkCreateDevice )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetDeviceProcAddr )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkEnumerateDeviceExtensionProperties )
@@ -56,14 +55,14 @@ INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfaceSupport
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfaceCapabilitiesKHR, VK_KHR_SURFACE_EXTENSION_NAME )
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfaceFormatsKHR, VK_KHR_SURFACE_EXTENSION_NAME )
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfacePresentModesKHR, VK_KHR_SURFACE_EXTENSION_NAME)
+INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkDestroySurfaceKHR, VK_KHR_SURFACE_EXTENSION_NAME)
 
 #ifdef VK_USE_PLATFORM_WIN32_KHR
 INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateWin32SurfaceKHR, VK_KHR_WIN32_SURFACE_EXTENSION_NAME )
-INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkDestroySurfaceKHR, VK_KHR_WIN32_SURFACE_EXTENSION_NAME)
 #elif defined VK_USE_PLATFORM_XCB_KHR
-INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateXcbSurfaceKHR, VK_KHR_XLIB_SURFACE_EXTENSION_NAME )
+INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateXcbSurfaceKHR, VK_KHR_XCB_SURFACE_EXTENSION_NAME )
 #elif defined VK_USE_PLATFORM_XLIB_KHR
-INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateXlibSurfaceKHR, VK_KHR_XCB_SURFACE_EXTENSION_NAME )
+INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION( vkCreateXlibSurfaceKHR, VK_KHR_XLIB_SURFACE_EXTENSION_NAME )
 #endif
 
 #undef INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION
@@ -92,11 +91,13 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateFence )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkResetFences )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyFence )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkWaitForFences )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetFenceStatus )
 
 DEVICE_LEVEL_VULKAN_FUNCTION( vkQueueWaitIdle )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDeviceWaitIdle )
 
 DEVICE_LEVEL_VULKAN_FUNCTION( vkQueueSubmit )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkQueueBindSparse )
 
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyDevice )
 
@@ -105,6 +106,7 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkFreeMemory )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkMapMemory )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkUnmapMemory )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkFlushMappedMemoryRanges )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkInvalidateMappedMemoryRanges )
 
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateBuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyBuffer )
@@ -116,6 +118,8 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyBufferView )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateImage )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyImage )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkGetImageMemoryRequirements )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetImageMemoryRequirements2 )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetImageSparseMemoryRequirements )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkBindImageMemory )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateImageView )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyImageView )
@@ -1,8 +1,25 @@
 #include "allocator.h"
 
+#include <algorithm>
+#include <sstream>
+
 AllocatorWrapper g_allocator;
 
 
+//remove handle from vector without keeping order, return false if it wasn't found
+template<typename T>
+bool removeHandle(vector<T>& handles, T handle){
+    for (uint32_t i = 0; i < handles.size(); i++){
+        if (handles[i] == handle){
+            handles[i] = handles.back();
+            handles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+
 //macro to define create functions for simple types
 #define create(type, name)                  \
 Vk##type VulkanAllocator::create##type(const Vk##type##CreateInfo & create_info){\
@@ -13,6 +30,26 @@ Vk##type VulkanAllocator::create##type(const Vk##type##CreateInfo & create_info)
     return name;                            \
 }
 
+//macro to define immediate and deferred destroy functions for simple types
+#define release(type, name)                 \
+void VulkanAllocator::destroy##type(Vk##type name){\
+    /*remove the object from the vector of created objects, then destroy it*/\
+    if (!removeHandle(m_##name##s, name)){     \
+        PRINT_ERROR("Destroy "#name" - object wasn't created by the allocator");\
+        return;                             \
+    }                                       \
+    vkDestroy##type(m_device, name, nullptr);\
+}                                           \
+void VulkanAllocator::release##type(Vk##type name){\
+    m_deferred_groups.back().m_##name##s.push_back(name);\
+}
+
+//macro to destroy all objects of one type in a deferred destruction group
+#define destroy_group(type, name)\
+for (Vk##type name : group.m_##name##s){        \
+    destroy##type(name);                        \
+}
+
 //macro to define for cycle to delete all objects
 #define delete(type, name)\
 for (Vk##type name : m_##name##s){              \
@@ -21,8 +58,42 @@ for (Vk##type name : m_##name##s){              \
 
 
 
-VulkanAllocator::VulkanAllocator(VkDevice device, VkPhysicalDevice physical_device) : 
-    m_device(device), m_physical_device(physical_device)
+DeferredDestructionGroup::DeferredDestructionGroup(uint64_t frame_index) : m_fence(VK_NULL_HANDLE), m_frame_index(frame_index)
+{}
+
+
+
+MemoryStatistics::MemoryStatistics() :
+    block_count(0), allocation_count(0), allocated_bytes(0), used_bytes(0), peak_used_bytes(0), largest_free_range(0), budget(0), usage(0)
+{}
+void MemoryStatistics::add(const MemoryStatistics& other){
+    block_count += other.block_count;
+    allocation_count += other.allocation_count;
+    allocated_bytes += other.allocated_bytes;
+    used_bytes += other.used_bytes;
+    peak_used_bytes = std::max(peak_used_bytes, other.peak_used_bytes);
+    largest_free_range = std::max(largest_free_range, other.largest_free_range);
+    budget += other.budget;
+    usage += other.usage;
+}
+float MemoryStatistics::fragmentation() const{
+    VkDeviceSize free_bytes = allocated_bytes - used_bytes;
+    if (free_bytes == 0) return 0.f;
+    return 1.f - (float) largest_free_range / free_bytes;
+}
+string MemoryStatistics::toJson() const{
+    std::stringstream json;
+    json << "{\"block_count\": " << block_count << ", \"allocation_count\": " << allocation_count
+         << ", \"allocated_bytes\": " << allocated_bytes << ", \"used_bytes\": " << used_bytes << ", \"peak_used_bytes\": " << peak_used_bytes
+         << ", \"largest_free_range\": " << largest_free_range << ", \"fragmentation\": " << fragmentation()
+         << ", \"budget\": " << budget << ", \"usage\": " << usage << "}";
+    return json.str();
+}
+
+
+
+VulkanAllocator::VulkanAllocator(VkDevice device, VkPhysicalDevice physical_device, bool memory_budget_enabled) : 
+    m_device(device), m_physical_device(physical_device), m_deferred_groups{DeferredDestructionGroup(0)}, m_frame_index(0), m_memory_budget(memory_budget_enabled)
 {
     //get device properties, then save device limits from them
     VkPhysicalDeviceProperties properties;
@@ -31,46 +102,180 @@ VulkanAllocator::VulkanAllocator(VkDevice device, VkPhysicalDevice physical_devi
 
     //get device memory properties
     vkGetPhysicalDeviceMemoryProperties(physical_device, &m_memory_properties);
+    //create an empty list of memory blocks for each memory type
+    m_memory_blocks.resize(m_memory_properties.memoryTypeCount);
+    //nothing is used yet
+    m_type_used.resize(m_memory_properties.memoryTypeCount, 0);
+    m_type_peak.resize(m_memory_properties.memoryTypeCount, 0);
+    m_heap_used.resize(m_memory_properties.memoryHeapCount, 0);
+    m_heap_peak.resize(m_memory_properties.memoryHeapCount, 0);
 }
 
 //define create functions for all simple types
 functionForAllTypes(create)
 
+//define destroy and release functions for all simple types
+functionForAllTypes(release)
 
-VkDeviceMemory VulkanAllocator::allocateMemory(VkDeviceSize size, uint32_t type_bits, VkMemoryPropertyFlags properties){
-    //Go over all memory types
-    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++){
-        //if memory is of correct type and has correct properties
-        if (((1 << i) & type_bits) && (m_memory_properties.memoryTypes[i].propertyFlags & properties) == properties){
-            //define allocate info structure
-            VkMemoryAllocateInfo allocate_info = {
-                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-                nullptr, size, i};
-            //allocate memory
-            VkDeviceMemory memory;
-            VkResult result = vkAllocateMemory(m_device, &allocate_info, nullptr, &memory);
-            //add it to vector of allocated memory and return it
-            m_allocated_memory.push_back(memory);
-            DEBUG_CHECK("Memory allocation", result)
-            return memory;
+
+MemoryAllocation VulkanAllocator::allocateMemory(VkDeviceSize size, uint32_t type_bits, const MemoryTypeRequest& request, VkDeviceSize alignment, MemoryResourceType resource_type){
+    return allocateBestType(size, type_bits, request, alignment, resource_type, nullptr);
+}
+MemoryAllocation VulkanAllocator::allocateDedicatedMemory(VkDeviceSize size, uint32_t type_bits, const MemoryTypeRequest& request, VkImage image, VkBuffer buffer){
+    //tell the driver which resource the memory is for
+    VkMemoryDedicatedAllocateInfo dedicated{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO, nullptr, image, buffer};
+    //the resource is always bound to the start of the block, no alignment is necessary
+    return allocateBestType(size, type_bits, request, 1, (image != VK_NULL_HANDLE) ? MEMORY_RESOURCE_OPTIMAL : MEMORY_RESOURCE_LINEAR, &dedicated);
+}
+MemoryAllocation VulkanAllocator::allocateBestType(VkDeviceSize size, uint32_t type_bits, const MemoryTypeRequest& request, VkDeviceSize alignment, MemoryResourceType resource_type,
+    const VkMemoryDedicatedAllocateInfo* dedicated)
+{
+    //try types from the best scoring one, if the heap of a type is exhausted, fall back to the next best one
+    uint32_t remaining_types = type_bits;
+    //heap budgets are respected first, if every type is over budget, try again and let the driver decide
+    bool respect_budget = m_memory_budget;
+    while (true){
+        uint32_t i = findMemoryType(remaining_types, request);
+        if (i == m_memory_properties.memoryTypeCount && respect_budget){
+            respect_budget = false;
+            remaining_types = type_bits;
+            continue;
+        }
+        //if no type of memory had the correct properties, print error
+        if (i == m_memory_properties.memoryTypeCount){
+            PRINT_ERROR("Suitable memory not found")
+            return MemoryAllocation();
+        }
+        MemoryAllocation allocation = allocateFromType(i, size, alignment, resource_type, respect_budget, dedicated);
+        if (allocation.valid()) return allocation;
+        remaining_types &= ~(1u << i);
+    }
+}
+MemoryAllocation VulkanAllocator::allocateFromType(uint32_t i, VkDeviceSize size, VkDeviceSize alignment, MemoryResourceType resource_type, bool respect_budget,
+    const VkMemoryDedicatedAllocateInfo* dedicated)
+{
+    VkMemoryPropertyFlags type_properties = m_memory_properties.memoryTypes[i].propertyFlags;
+    //non-coherent host visible memory is flushed in multiples of nonCoherentAtomSize, align both ends of the allocation to it.
+    //Dedicated memory must have exactly the size of the resource, it starts at the block start and its' end is the end of the block, which can always be flushed
+    if (dedicated == nullptr && (type_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(type_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)){
+        alignment = std::max(alignment, m_device_limits.nonCoherentAtomSize);
+        size = ((size + alignment - 1) / alignment) * alignment;
+    }
+    //try to place the memory into one of the existing blocks, dedicated memory always gets a new one
+    VkDeviceSize offset;
+    for (MemoryBlock& block : m_memory_blocks[i]){
+        if (dedicated != nullptr) break;
+        if (!block.isDedicated() && block.allocate(size, alignment, resource_type, offset)){
+            trackUsage(i, size, false);
+            return MemoryAllocation(block.getMemory(), offset, size, i);
+        }
+    }
+    //no block has enough space - allocate a new one. Small heaps use smaller blocks, large resources get a block of their own
+    VkDeviceSize heap_size = m_memory_properties.memoryHeaps[m_memory_properties.memoryTypes[i].heapIndex].size;
+    VkDeviceSize block_size = (heap_size < MEMORY_BLOCK_SMALL_HEAP_SIZE) ? heap_size / MEMORY_BLOCK_SMALL_HEAP_DIVISOR : MEMORY_BLOCK_SIZE;
+    if (size > block_size / 2 || dedicated != nullptr) block_size = size;
+    //going over the heap budget makes the driver move memory out of the heap, use a smaller block or give up on the type
+    if (respect_budget){
+        MemoryStatistics heap_statistics = getHeapStatistics(m_memory_properties.memoryTypes[i].heapIndex);
+        if (heap_statistics.usage + block_size > heap_statistics.budget) block_size = size;
+        if (heap_statistics.usage + size > heap_statistics.budget) return MemoryAllocation();
+    }
+    //define allocate info structure
+    VkMemoryAllocateInfo allocate_info = {
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        dedicated, block_size, i};
+    //allocate memory
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(m_device, &allocate_info, nullptr, &memory);
+    //if the heap cannot fit a whole block, try to allocate just the requested size
+    if (result != VK_SUCCESS && block_size != size){
+        allocate_info.allocationSize = block_size = size;
+        result = vkAllocateMemory(m_device, &allocate_info, nullptr, &memory);
+    }
+    //the heap is full, let the caller try another memory type. Types skipped only for being over budget don't warn, that is expected
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY){
+        PRINT_WARN("Memory heap " << m_memory_properties.memoryTypes[i].heapIndex << " is exhausted, falling back to the next best memory type")
+        return MemoryAllocation();
+    }
+    DEBUG_CHECK("Memory allocation", result)
+    //add it to vector of memory blocks, then reserve the requested range inside it
+    m_memory_blocks[i].push_back(MemoryBlock(memory, block_size, m_device_limits.bufferImageGranularity, dedicated != nullptr));
+    m_memory_blocks[i].back().allocate(size, alignment, resource_type, offset);
+    trackUsage(i, size, false);
+    return MemoryAllocation(memory, offset, size, i);
+}
+MemoryAllocation VulkanAllocator::allocateForRelocation(const MemoryAllocation& allocation, VkDeviceSize alignment, MemoryResourceType resource_type){
+    MemoryBlock* source = findBlock(allocation.memory);
+    if (source == nullptr || source->isDedicated()) return MemoryAllocation();
+    VkDeviceSize source_used = source->getUsedSize();
+    //collect all blocks that are fuller than the source, then try them from the fullest one
+    vector<MemoryBlock*> targets;
+    for (MemoryBlock& block : m_memory_blocks[allocation.memory_type]){
+        if (&block != source && !block.isDedicated() && block.getUsedSize() > source_used) targets.push_back(&block);
+    }
+    std::sort(targets.begin(), targets.end(), [](MemoryBlock* a, MemoryBlock* b){
+        return a->getUsedSize() > b->getUsedSize();
+    });
+    VkDeviceSize offset;
+    for (MemoryBlock* block : targets){
+        if (block->allocate(allocation.size, alignment, resource_type, offset)){
+            trackUsage(allocation.memory_type, allocation.size, false);
+            return MemoryAllocation(block->getMemory(), offset, allocation.size, allocation.memory_type);
+        }
+    }
+    return MemoryAllocation();
+}
+VkDeviceSize VulkanAllocator::getBlockUsedSize(VkDeviceMemory memory){
+    MemoryBlock* block = findBlock(memory);
+    return (block == nullptr) ? 0 : block->getUsedSize();
+}
+void VulkanAllocator::free(const MemoryAllocation& allocation){
+    if (!allocation.valid()) return;
+    vector<MemoryBlock>& blocks = m_memory_blocks[allocation.memory_type];
+    for (uint32_t i = 0; i < blocks.size(); i++){
+        if (blocks[i].getMemory() != allocation.memory) continue;
+        blocks[i].free(allocation.offset);
+        trackUsage(allocation.memory_type, allocation.size, true);
+        if (!blocks[i].empty()) return;
+        //dedicated blocks can't be reused by other resources
+        if (blocks[i].isDedicated()){
+            blocks[i].destroy(m_device);
+            blocks.erase(blocks.begin() + i);
+            return;
+        }
+        //keep one empty block per memory type to avoid reallocating when resources are recreated, release any other one
+        for (uint32_t j = 0; j < blocks.size(); j++){
+            if (j != i && blocks[j].empty()){
+                blocks[i].destroy(m_device);
+                blocks.erase(blocks.begin() + i);
+                return;
+            }
         }
+        return;
     }
-    //if no type of memory had the correct properties, print error
-    PRINT_ERROR("Suitable memory not found")
-    return VK_NULL_HANDLE;
+    PRINT_ERROR("Freeing memory that wasn't allocated by this allocator")
 }
 void* VulkanAllocator::mapMemory(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size){
-    //get pointer to the memory
-    void* ptr;
-    VkResult result = vkMapMemory(m_device, memory, offset, size, 0, &ptr);
-    DEBUG_CHECK("Memory mapping", result)
-    //if memory has been mapped before, return the pointer
-    for (VkDeviceMemory m : m_mapped_memory){
-        if (m == memory) return ptr;
-    }
-    //if it isn't mapped yet, add it to the vector of mapped memory and return pointer
-    m_mapped_memory.push_back(memory);
-    return ptr;
+    //find the block the memory belongs to
+    MemoryBlock* block = findBlock(memory);
+    if (block == nullptr){
+        PRINT_ERROR("Mapping memory that wasn't allocated by this allocator")
+        return nullptr;
+    }
+    if (offset + size > block->getSize()) PRINT_ERROR("Mapped range is outside of memory bounds")
+    //get pointer to the start of the block, then move it by offset
+    return reinterpret_cast<uint8_t*>(block->map(m_device)) + offset;
+}
+void* VulkanAllocator::mapMemory(const MemoryAllocation& allocation){
+    return mapMemory(allocation.memory, allocation.offset, allocation.size);
+}
+MemoryBlock* VulkanAllocator::findBlock(VkDeviceMemory memory){
+    for (vector<MemoryBlock>& blocks : m_memory_blocks){
+        for (MemoryBlock& block : blocks){
+            if (block.getMemory() == memory) return &block;
+        }
+    }
+    return nullptr;
 }
 VkPipeline VulkanAllocator::createPipeline(const VkGraphicsPipelineCreateInfo& info){
     //Create a graphics pipeline using given info, add it to vector of pipelines, then return it's handle
@@ -96,9 +301,166 @@ VkSwapchainKHR VulkanAllocator::createSwapchain(const VkSwapchainCreateInfoKHR&
     m_swapchains.push_back(swapchain);
     return swapchain;
 }
+void VulkanAllocator::destroyPipeline(VkPipeline pipeline){
+    if (!removeHandle(m_pipelines, pipeline)){
+        PRINT_ERROR("Destroy pipeline - object wasn't created by the allocator")
+        return;
+    }
+    vkDestroyPipeline(m_device, pipeline, nullptr);
+}
+void VulkanAllocator::destroySwapchain(VkSwapchainKHR swapchain){
+    if (!removeHandle(m_swapchains, swapchain)){
+        PRINT_ERROR("Destroy swapchain - object wasn't created by the allocator")
+        return;
+    }
+    vkDestroySwapchainKHR(m_device, swapchain, nullptr);
+}
+void VulkanAllocator::releasePipeline(VkPipeline pipeline){
+    m_deferred_groups.back().m_pipelines.push_back(pipeline);
+}
+void VulkanAllocator::releaseSwapchain(VkSwapchainKHR swapchain){
+    m_deferred_groups.back().m_swapchains.push_back(swapchain);
+}
+void VulkanAllocator::releaseMemory(const MemoryAllocation& allocation){
+    m_deferred_groups.back().m_memory.push_back(allocation);
+}
+void VulkanAllocator::endFrame(VkFence fence){
+    m_frame_index++;
+    //a frame without a fence (nothing was submitted) can't be waited for, its' objects are merged into the next frame and destroyed with it
+    if (fence == VK_NULL_HANDLE){
+        retireFrames();
+        return;
+    }
+    //the current group will be destroyed once the fence signals, start a new group for the next frame
+    m_deferred_groups.back().m_fence = fence;
+    m_deferred_groups.push_back(DeferredDestructionGroup(m_frame_index));
+    retireFrames();
+}
+void VulkanAllocator::retireFrames(){
+    //frames finish in order, go from the oldest one and stop at the first that isn't finished yet. The last group is still being recorded
+    uint32_t finished = 0;
+    while (finished + 1 < m_deferred_groups.size() && vkGetFenceStatus(m_device, m_deferred_groups[finished].m_fence) == VK_SUCCESS){
+        destroyGroup(m_deferred_groups[finished]);
+        finished++;
+    }
+    m_deferred_groups.erase(m_deferred_groups.begin(), m_deferred_groups.begin() + finished);
+}
+uint64_t VulkanAllocator::getFrameIndex() const{
+    return m_frame_index;
+}
+void VulkanAllocator::destroyGroup(DeferredDestructionGroup& group){
+    //destroy all simple type objects, then pipelines and swapchains, and free memory last
+    functionForAllTypes(destroy_group)
+    for (VkPipeline p : group.m_pipelines){
+        destroyPipeline(p);
+    }
+    for (VkSwapchainKHR s : group.m_swapchains){
+        destroySwapchain(s);
+    }
+    for (const MemoryAllocation& m : group.m_memory){
+        free(m);
+    }
+}
 const VkPhysicalDeviceLimits& VulkanAllocator::getLimits() const{
     return m_device_limits;
 }
+uint32_t VulkanAllocator::findMemoryType(uint32_t type_bits, const MemoryTypeRequest& request) const{
+    //Go over all memory types allowed by type_bits and return the one with the highest score. Vulkan orders types by performance, so the first one wins ties
+    uint32_t best = m_memory_properties.memoryTypeCount;
+    int best_score = -1;
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++){
+        if (!((1 << i) & type_bits)) continue;
+        int score = request.score(m_memory_properties.memoryTypes[i].propertyFlags);
+        if (score > best_score){
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+VkMemoryPropertyFlags VulkanAllocator::getMemoryTypeProperties(uint32_t memory_type) const{
+    return m_memory_properties.memoryTypes[memory_type].propertyFlags;
+}
+void VulkanAllocator::trackUsage(uint32_t memory_type, VkDeviceSize size, bool freeing){
+    uint32_t heap = m_memory_properties.memoryTypes[memory_type].heapIndex;
+    if (freeing){
+        m_type_used[memory_type] -= size;
+        m_heap_used[heap] -= size;
+        return;
+    }
+    m_type_used[memory_type] += size;
+    m_heap_used[heap] += size;
+    m_type_peak[memory_type] = std::max(m_type_peak[memory_type], m_type_used[memory_type]);
+    m_heap_peak[heap] = std::max(m_heap_peak[heap], m_heap_used[heap]);
+}
+MemoryStatistics VulkanAllocator::getTypeStatistics(uint32_t memory_type) const{
+    MemoryStatistics stats;
+    //blocks are gone after the allocator was destroyed
+    if (memory_type >= m_memory_blocks.size()) return stats;
+    for (const MemoryBlock& block : m_memory_blocks[memory_type]){
+        stats.block_count++;
+        stats.allocation_count += block.getAllocationCount();
+        stats.allocated_bytes += block.getSize();
+        stats.largest_free_range = std::max(stats.largest_free_range, block.getLargestFreeRange());
+    }
+    //sizes of allocations are tracked, summing ranges of blocks would count alignment padding as used as well
+    stats.used_bytes = m_type_used[memory_type];
+    stats.peak_used_bytes = m_type_peak[memory_type];
+    return stats;
+}
+MemoryStatistics VulkanAllocator::getHeapStatistics(uint32_t heap_index) const{
+    //sum statistics of all types in the heap
+    MemoryStatistics stats;
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++){
+        if (m_memory_properties.memoryTypes[i].heapIndex == heap_index) stats.add(getTypeStatistics(i));
+    }
+    //the heap peak isn't the maximum of type peaks, types can peak at different times
+    stats.peak_used_bytes = m_heap_peak[heap_index];
+    if (m_memory_budget){
+        //ask the driver how much memory this process uses and how much it can use, this includes memory of other libraries and implicit allocations
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT, nullptr, {}, {}};
+        VkPhysicalDeviceMemoryProperties2 properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, &budget_properties, {}};
+        vkGetPhysicalDeviceMemoryProperties2(m_physical_device, &properties);
+        stats.budget = budget_properties.heapBudget[heap_index];
+        stats.usage = budget_properties.heapUsage[heap_index];
+    }else{
+        //without the extension, the best estimate is the whole heap and the blocks allocated by this allocator
+        stats.budget = m_memory_properties.memoryHeaps[heap_index].size;
+        stats.usage = stats.allocated_bytes;
+    }
+    return stats;
+}
+MemoryStatistics VulkanAllocator::getTotalStatistics() const{
+    MemoryStatistics stats;
+    VkDeviceSize peak = 0;
+    for (uint32_t i = 0; i < m_memory_properties.memoryHeapCount; i++){
+        stats.add(getHeapStatistics(i));
+        peak += m_heap_peak[i];
+    }
+    //heaps are independent, the sum of their peaks is an upper bound of the total peak
+    stats.peak_used_bytes = peak;
+    return stats;
+}
+string VulkanAllocator::getStatisticsJson() const{
+    std::stringstream json;
+    json << "{\n  \"total\": " << getTotalStatistics().toJson() << ",\n  \"heaps\": [";
+    for (uint32_t i = 0; i < m_memory_properties.memoryHeapCount; i++){
+        const VkMemoryHeap& heap = m_memory_properties.memoryHeaps[i];
+        json << ((i == 0) ? "\n" : ",\n") << "    {\"index\": " << i << ", \"size\": " << heap.size << ", \"flags\": " << heap.flags
+             << ", \"statistics\": " << getHeapStatistics(i).toJson() << ", \"types\": [";
+        //list all memory types that belong to this heap
+        bool first = true;
+        for (uint32_t j = 0; j < m_memory_properties.memoryTypeCount; j++){
+            if (m_memory_properties.memoryTypes[j].heapIndex != i) continue;
+            json << (first ? "\n" : ",\n") << "      {\"index\": " << j << ", \"flags\": " << m_memory_properties.memoryTypes[j].propertyFlags
+                 << ", \"statistics\": " << getTypeStatistics(j).toJson() << "}";
+            first = false;
+        }
+        json << (first ? "]}" : "\n    ]}");
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
 VkDevice VulkanAllocator::getDevice() const{
     return m_device;
 }
@@ -111,13 +473,16 @@ void VulkanAllocator::destroy()
 {
     //delete all elements in simple type vectors
     functionForAllTypes(delete)
-    //unmap all mapped memory, then deallocate all memory
-    for (VkDeviceMemory m : m_mapped_memory){
-        vkUnmapMemory(m_device, m);
-    }
-    for (VkDeviceMemory m : m_allocated_memory){
-        vkFreeMemory(m_device, m, nullptr);
+    //unmap and deallocate all memory blocks
+    for (vector<MemoryBlock>& blocks : m_memory_blocks){
+        for (MemoryBlock& block : blocks){
+            block.destroy(m_device);
+        }
     }
+    m_memory_blocks.clear();
+    //all released objects were still held in the vectors above, forget the groups
+    m_deferred_groups.clear();
+    m_deferred_groups.push_back(DeferredDestructionGroup(m_frame_index));
     
     //delete all pipelines and swapchains
     for (VkPipeline p : m_pipelines){
@@ -151,4 +516,6 @@ VulkanAllocator& AllocatorWrapper::get()
 }
 
 #undef create
+#undef release
+#undef destroy_group
 #undef delete
\ No newline at end of file
@@ -8,9 +8,13 @@
 
 
 #include "../00_base/vulkan_base.h"
+#include "memory_block.h"
 
 #define vector(type, name) vector<Vk##type> m_##name##s;
 #define function(type, name) Vk##type create##type(const Vk##type##CreateInfo& create_info);
+#define release_function(type, name) \
+    void destroy##type(Vk##type name);\
+    void release##type(Vk##type name);
 
 //List of all simple vulkan types, these follow a simple pattern that can be automatically generated by the preprocessor
 #define functionForAllTypes(func) \
@@ -31,6 +35,65 @@ func(CommandPool, command_pool)
 
 
 class Device;
+class VulkanAllocator;
+
+
+/**
+ * DeferredDestructionGroup
+ *  - Holds all objects released during one frame, they are destroyed once the fence of the frame becomes signaled
+ */
+class DeferredDestructionGroup{
+    //fence signaled when the frame finishes on the GPU, VK_NULL_HANDLE while the frame is still being recorded
+    VkFence m_fence;
+    //index of the frame the objects were released in
+    uint64_t m_frame_index;
+    //one vector for every simple type, same as in VulkanAllocator
+    functionForAllTypes(vector)
+    vector<VkPipeline> m_pipelines;
+    vector<VkSwapchainKHR> m_swapchains;
+    vector<MemoryAllocation> m_memory;
+public:
+    DeferredDestructionGroup(uint64_t frame_index);
+    friend class VulkanAllocator;
+};
+
+
+/**
+ * MemoryStatistics
+ *  - Memory usage of one memory type, one heap, or the whole device, as returned by VulkanAllocator
+ */
+class MemoryStatistics{
+public:
+    //how many memory blocks (VkDeviceMemory objects) are allocated
+    uint32_t block_count;
+    //how many sub-allocations live inside the blocks
+    uint32_t allocation_count;
+    //total size of all blocks in bytes
+    VkDeviceSize allocated_bytes;
+    //bytes occupied by sub-allocations
+    VkDeviceSize used_bytes;
+    //highest used_bytes value since the allocator was created
+    VkDeviceSize peak_used_bytes;
+    //largest continuous free range in any block
+    VkDeviceSize largest_free_range;
+    //how much memory the process can use according to VK_EXT_memory_budget, heap size if the extension isn't enabled. Zero for memory types
+    VkDeviceSize budget;
+    //how much memory the process uses according to VK_EXT_memory_budget, equal to allocated_bytes if the extension isn't enabled. Zero for memory types
+    VkDeviceSize usage;
+
+    //create empty statistics
+    MemoryStatistics();
+
+    //add counts and sizes of other statistics to these ones, peak and largest free range are maximized
+    void add(const MemoryStatistics& other);
+
+    //return 0 if all free space in blocks forms one continuous range, values close to 1 mean free space is split into many small ranges
+    float fragmentation() const;
+
+    //return the statistics as a JSON object
+    string toJson() const;
+};
+
 
 /**
  * VulkanAllocator
@@ -52,32 +115,87 @@ class VulkanAllocator
     //Pipelines need special creation functions based on their type
     vector<VkPipeline> m_pipelines;
     vector<VkSwapchainKHR> m_swapchains;
-    //All allocated memory visible to the GPU
-    vector<VkDeviceMemory> m_allocated_memory;
-    //Mapped memory is visible to both GPU and CPU
-    vector<VkDeviceMemory> m_mapped_memory;
+    //Large blocks of memory visible to the GPU, one vector for each memory type. Memory objects are sub-allocated from these
+    vector<vector<MemoryBlock>> m_memory_blocks;
+
+    //Objects waiting for destruction, grouped by frame. The last group belongs to the frame currently being recorded
+    vector<DeferredDestructionGroup> m_deferred_groups;
+    //Index of the frame currently being recorded, incremented by each endFrame() call
+    uint64_t m_frame_index;
+
+    //bytes used by sub-allocations and their peak values, one value for each memory type and each memory heap
+    vector<VkDeviceSize> m_type_used;
+    vector<VkDeviceSize> m_type_peak;
+    vector<VkDeviceSize> m_heap_used;
+    vector<VkDeviceSize> m_heap_peak;
+    //whether VK_EXT_memory_budget is enabled on the device, heap budgets are queried from the driver if it is
+    bool m_memory_budget;
 public:
-    //create a new allocator and initiate m_memory_properties and m_device_limits
-    VulkanAllocator(VkDevice device, VkPhysicalDevice physical_device);
+    /**
+     * Create a new allocator and initiate m_memory_properties and m_device_limits
+     * @param device the logical device
+     * @param physical_device the device it was created from
+     * @param memory_budget_enabled true if the device was created with VK_EXT_memory_budget
+     */
+    VulkanAllocator(VkDevice device, VkPhysicalDevice physical_device, bool memory_budget_enabled = false);
 
     //declare create functions for all simple types
     functionForAllTypes(function)
+
+    //declare destroy and release functions for all simple types.
+    //destroy##type destroys the object immediately, the object must not be in use by the device.
+    //release##type queues the object for destruction, it is destroyed once the fence passed to endFrame() of the current frame signals
+    functionForAllTypes(release_function)
     
     /**
-     * Allocate memory visible to the GPU
+     * Allocate memory visible to the GPU. The memory is placed inside a larger block, a new block is allocated only when no existing one has enough space.
+     * If the heap of the best memory type is exhausted, the next best type is used.
      * @param size memory size in bytes
      * @param type_bits what type does the memory need to have, these are generated automatically by the classes reserving memory for buffers / images
-     * @param properties most common VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, valid values VK_MEMORY_PROPERTY_***
+     * @param request required, preferred and forbidden properties and usage of the memory, or just required VK_MEMORY_PROPERTY_*** flags, most common VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+     * @param alignment the offset of returned memory will be a multiple of this value
+     * @param resource_type what kind of resources will be bound to the memory, used to respect bufferImageGranularity
      */
-    VkDeviceMemory allocateMemory(VkDeviceSize size, uint32_t type_bits, VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    MemoryAllocation allocateMemory(VkDeviceSize size, uint32_t type_bits, const MemoryTypeRequest& request = MemoryTypeRequest(),
+        VkDeviceSize alignment = 1, MemoryResourceType resource_type = MEMORY_RESOURCE_LINEAR);
+
+    /**
+     * Allocate a separate block of memory for one image or buffer. Drivers may place such allocations better, e.g. use framebuffer compression for large render targets.
+     * The block is freed as soon as the allocation is.
+     * @param size size of the resource in bytes
+     * @param type_bits memory type bits from resource memory requirements
+     * @param request required, preferred and forbidden properties and usage of the memory
+     * @param image the image the memory is for, VK_NULL_HANDLE if it is for a buffer
+     * @param buffer the buffer the memory is for, VK_NULL_HANDLE if it is for an image
+     */
+    MemoryAllocation allocateDedicatedMemory(VkDeviceSize size, uint32_t type_bits, const MemoryTypeRequest& request, VkImage image, VkBuffer buffer = VK_NULL_HANDLE);
+
+    /**
+     * Allocate memory for moving an existing allocation to a fuller block, used to compact memory.
+     * Only blocks of the same memory type that have more used bytes than the block of the allocation are considered, the fullest one first.
+     * Returns an invalid allocation if there is no such block with enough free space - moving the allocation wouldn't make any block emptier.
+     * @param allocation the allocation that will be moved, it has to be freed by the caller afterwards
+     * @param alignment alignment of the new allocation
+     * @param resource_type what kind of resources will be bound to the memory
+     */
+    MemoryAllocation allocateForRelocation(const MemoryAllocation& allocation, VkDeviceSize alignment, MemoryResourceType resource_type);
+
+    //Return the number of bytes used by sub-allocations in the block given memory belongs to, 0 if it wasn't allocated by this allocator
+    VkDeviceSize getBlockUsedSize(VkDeviceMemory memory);
+
+    //Return memory to its' block so it can be reused. Blocks that become empty are released, except for one spare block per memory type. Dedicated blocks are always released
+    void free(const MemoryAllocation& allocation);
     
     /**
-     * Map memory - get a pointer to CPU/GPU shared memory
+     * Map memory - get a pointer to CPU/GPU shared memory. The whole block is mapped on first use and stays mapped until it is freed
      * @param memory the memory to get pointer to
      * @param offset offset from memory start
      * @param size how many bytes have to be mapped
      */
     void* mapMemory(VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size);
+
+    //Map memory - get a pointer to the start of given allocation
+    void* mapMemory(const MemoryAllocation& allocation);
     
     //Create graphics pipeline
     VkPipeline createPipeline(const VkGraphicsPipelineCreateInfo& info);
@@ -88,6 +206,28 @@ public:
     //Create swapchain
     VkSwapchainKHR createSwapchain(const VkSwapchainCreateInfoKHR& info);
 
+    //Destroy pipeline or swapchain immediately
+    void destroyPipeline(VkPipeline pipeline);
+    void destroySwapchain(VkSwapchainKHR swapchain);
+
+    //Queue pipeline, swapchain or memory for destruction after the current frame finishes
+    void releasePipeline(VkPipeline pipeline);
+    void releaseSwapchain(VkSwapchainKHR swapchain);
+    void releaseMemory(const MemoryAllocation& allocation);
+
+    /**
+     * End the frame currently being recorded. All objects released since the last call will be destroyed once the fence signals.
+     * Call this after submitting the last command buffer of the frame with the fence. Also destroys objects of all finished frames.
+     * @param fence fence that becomes signaled when the GPU finishes the frame, VK_NULL_HANDLE if nothing was submitted - objects are then destroyed with the next frame
+     */
+    void endFrame(VkFence fence);
+
+    //Destroy objects of all frames whose fences are already signaled
+    void retireFrames();
+
+    //Get the index of the frame currently being recorded
+    uint64_t getFrameIndex() const;
+
     //Get a handle to device
     VkDevice getDevice() const;
 
@@ -97,8 +237,46 @@ public:
     //Get a reference to device limits
     const VkPhysicalDeviceLimits& getLimits() const;
 
+    //Get property flags of given memory type, e.g. to check whether an allocation is host coherent
+    VkMemoryPropertyFlags getMemoryTypeProperties(uint32_t memory_type) const;
+
+    //Get statistics of all blocks of given memory type
+    MemoryStatistics getTypeStatistics(uint32_t memory_type) const;
+
+    //Get statistics of all memory types in given heap, budget and usage are filled in as well
+    MemoryStatistics getHeapStatistics(uint32_t heap_index) const;
+
+    //Get statistics of all heaps together
+    MemoryStatistics getTotalStatistics() const;
+
+    //Return statistics of the whole device, every heap and every memory type as a JSON string, useful for dumping to a file when debugging memory usage
+    string getStatisticsJson() const;
+
     //Destroy all the objects associated with this allocator
     void destroy();
+private:
+    //Find the block a memory object belongs to, returns nullptr if it wasn't allocated by this allocator
+    MemoryBlock* findBlock(VkDeviceMemory memory);
+
+    //Return index of the best scoring memory type allowed by type_bits, or memoryTypeCount if none can be used
+    uint32_t findMemoryType(uint32_t type_bits, const MemoryTypeRequest& request) const;
+
+    //Allocate memory from the best memory type that has free space, dedicated is nullptr for ordinary allocations
+    MemoryAllocation allocateBestType(VkDeviceSize size, uint32_t type_bits, const MemoryTypeRequest& request, VkDeviceSize alignment, MemoryResourceType resource_type,
+        const VkMemoryDedicatedAllocateInfo* dedicated);
+
+    /**
+     * Allocate memory from given memory type, return an invalid allocation if its' heap is out of memory, or a new block wouldn't fit into the heap budget when respect_budget is set
+     * If dedicated isn't nullptr, a new block just for the given resource is allocated
+     */
+    MemoryAllocation allocateFromType(uint32_t memory_type, VkDeviceSize size, VkDeviceSize alignment, MemoryResourceType resource_type, bool respect_budget,
+        const VkMemoryDedicatedAllocateInfo* dedicated);
+
+    //Destroy all objects in a group of released objects
+    void destroyGroup(DeferredDestructionGroup& group);
+
+    //Add size to used bytes of given memory type and its' heap, or subtract it when freeing. Peaks are updated as well
+    void trackUsage(uint32_t memory_type, VkDeviceSize size, bool freeing);
 };
 
 
@@ -125,5 +303,6 @@ extern AllocatorWrapper g_allocator;
 
 #undef vector
 #undef function
+#undef release_function
 
 #endif
\ No newline at end of file
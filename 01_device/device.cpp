@@ -23,8 +23,8 @@ void Queue::submit(VkCommandBuffer command_buffer, const SubmitSynchronization&
 }
 
 
-Device::Device(VkDevice device, VkPhysicalDevice physical_device, const vector<VkDeviceQueueCreateInfo>& queue_infos) : 
-    m_device(device), m_allocator{device, physical_device}, m_queues(queue_infos.size())
+Device::Device(VkDevice device, VkPhysicalDevice physical_device, const vector<VkDeviceQueueCreateInfo>& queue_infos, const vector<const char*>& extensions) : 
+    m_device(device), m_allocator{device, physical_device, extensionEnabled(extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)}, m_queues(queue_infos.size())
 {
     //set the global allocator variable
     g_allocator.set(m_allocator);
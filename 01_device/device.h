@@ -30,8 +30,9 @@ public:
      * @param device
      * @param physical_device
      * @param queue_infos the queue infos, with which the device was created, now used to request queues from created device
+     * @param extensions extensions enabled on the device, the allocator uses VK_EXT_memory_budget if it is present
      */
-    Device(VkDevice device, VkPhysicalDevice physical_device, const vector<VkDeviceQueueCreateInfo>& queue_infos);
+    Device(VkDevice device, VkPhysicalDevice physical_device, const vector<VkDeviceQueueCreateInfo>& queue_infos, const vector<const char*>& extensions);
 
     //Wait for all operations on the device to finish executing 
     void waitFor() const;
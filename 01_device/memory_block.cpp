@@ -0,0 +1,203 @@
+#include "memory_block.h"
+#include <algorithm>
+
+
+//round offset up to the nearest multiple of alignment
+static VkDeviceSize alignOffset(VkDeviceSize offset, VkDeviceSize alignment){
+    return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+//return the number of set bits
+static int countBits(VkMemoryPropertyFlags flags){
+    int count = 0;
+    for (; flags != 0; flags &= flags - 1) count++;
+    return count;
+}
+
+
+
+MemoryTypeRequest::MemoryTypeRequest(VkMemoryPropertyFlags required_, VkMemoryPropertyFlags preferred_, VkMemoryPropertyFlags forbidden_, MemoryUsage usage_) :
+    required(required_), preferred(preferred_), forbidden(forbidden_), usage(usage_)
+{}
+MemoryTypeRequest::MemoryTypeRequest(MemoryUsage usage_) : MemoryTypeRequest(0, 0, 0, usage_)
+{
+    switch (usage){
+        case MEMORY_USAGE_GPU_ONLY:
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case MEMORY_USAGE_UPLOAD:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+        case MEMORY_USAGE_READBACK:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+        case MEMORY_USAGE_FREQUENT_UPDATE:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+        default:
+            break;
+    }
+}
+int MemoryTypeRequest::score(VkMemoryPropertyFlags type_properties) const{
+    if ((type_properties & required) != required || (type_properties & forbidden)) return -1;
+    //protected and lazily allocated memory can't be used for ordinary resources, never pick it unless asked to
+    const VkMemoryPropertyFlags special = VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    if (type_properties & special & ~(required | preferred)) return -1;
+    //every preferred flag is worth more than all usage hints together, the base value keeps scores of usable types positive after penalties
+    int score = 32 + 16 * countBits(type_properties & preferred);
+    switch (usage){
+        case MEMORY_USAGE_GPU_ONLY:
+            //host visible device local memory is usually a small heap, keep it for data the CPU writes
+            if (type_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) score -= 4;
+            break;
+        case MEMORY_USAGE_UPLOAD:
+            //the copy reads faster from device local memory, and uncached (write-combined) memory is faster for sequential CPU writes
+            if (type_properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) score += 2;
+            if (type_properties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) score -= 4;
+            break;
+        case MEMORY_USAGE_READBACK:
+            //reading device local memory from the CPU goes over the bus for every access
+            if (type_properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) score -= 4;
+            break;
+        case MEMORY_USAGE_FREQUENT_UPDATE:
+            if (type_properties & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) score -= 4;
+            break;
+        default:
+            break;
+    }
+    //a request of just flags picks the first type with them, as the lowest index is the fastest one
+    if (usage == MEMORY_USAGE_UNKNOWN && preferred == 0) return score;
+    //among otherwise equal types, use the one with the least unrequested properties
+    return score - countBits(type_properties & ~(required | preferred));
+}
+
+
+
+MemoryAllocation::MemoryAllocation() : memory(VK_NULL_HANDLE), offset(0), size(0), memory_type(0)
+{}
+MemoryAllocation::MemoryAllocation(VkDeviceMemory memory_, VkDeviceSize offset_, VkDeviceSize size_, uint32_t memory_type_) :
+    memory(memory_), offset(offset_), size(size_), memory_type(memory_type_)
+{}
+bool MemoryAllocation::valid() const{
+    return (memory != VK_NULL_HANDLE);
+}
+
+
+
+MemoryBlockRange::MemoryBlockRange(VkDeviceSize offset_, VkDeviceSize size_, MemoryResourceType type_) :
+    offset(offset_), size(size_), type(type_)
+{}
+VkDeviceSize MemoryBlockRange::end() const{
+    return offset + size;
+}
+bool MemoryBlockRange::isFree() const{
+    return type == MEMORY_RESOURCE_FREE;
+}
+
+
+
+MemoryBlock::MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, VkDeviceSize buffer_image_granularity, bool dedicated) :
+    m_memory(memory), m_size(size), m_granularity(buffer_image_granularity), m_mapped_data(nullptr), m_dedicated(dedicated), m_ranges{MemoryBlockRange(0, size, MEMORY_RESOURCE_FREE)}
+{}
+bool MemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, MemoryResourceType type, VkDeviceSize& offset){
+    //first fit - go through all free ranges and use the first one the resource fits into
+    for (uint32_t i = 0; i < m_ranges.size(); i++){
+        const MemoryBlockRange& range = m_ranges[i];
+        if (!range.isFree() || range.size < size) continue;
+        VkDeviceSize start = alignOffset(range.offset, alignment);
+        //the previous range is always used, if it holds a resource of a different kind on the same page, move to the next page
+        if (i > 0 && conflicting(m_ranges[i - 1].type, type) && samePage(m_ranges[i - 1].end() - 1, start)){
+            start = alignOffset(start, m_granularity);
+        }
+        //if the resource doesn't fit after alignment, try next range
+        if (start + size > range.end()) continue;
+        //the next range is always used as well, check whether it doesn't share a page with the end of the resource
+        if (i + 1 < m_ranges.size() && conflicting(m_ranges[i + 1].type, type) && samePage(start + size - 1, m_ranges[i + 1].offset)) continue;
+
+        //split the free range into (padding, resource, remainder), padding and remainder are left free
+        VkDeviceSize padding = start - range.offset;
+        VkDeviceSize remainder = range.end() - (start + size);
+        m_ranges[i] = MemoryBlockRange(start, size, type);
+        if (remainder != 0) m_ranges.insert(m_ranges.begin() + i + 1, MemoryBlockRange(start + size, remainder, MEMORY_RESOURCE_FREE));
+        if (padding != 0) m_ranges.insert(m_ranges.begin() + i, MemoryBlockRange(start - padding, padding, MEMORY_RESOURCE_FREE));
+        offset = start;
+        return true;
+    }
+    return false;
+}
+void MemoryBlock::free(VkDeviceSize offset){
+    for (uint32_t i = 0; i < m_ranges.size(); i++){
+        if (m_ranges[i].offset != offset || m_ranges[i].isFree()) continue;
+        m_ranges[i].type = MEMORY_RESOURCE_FREE;
+        //merge with the next range if it is free
+        if (i + 1 < m_ranges.size() && m_ranges[i + 1].isFree()){
+            m_ranges[i].size += m_ranges[i + 1].size;
+            m_ranges.erase(m_ranges.begin() + i + 1);
+        }
+        //merge with the previous range if it is free
+        if (i > 0 && m_ranges[i - 1].isFree()){
+            m_ranges[i - 1].size += m_ranges[i].size;
+            m_ranges.erase(m_ranges.begin() + i);
+        }
+        return;
+    }
+    PRINT_ERROR("Freeing memory range that wasn't allocated, offset: " << offset)
+}
+bool MemoryBlock::empty() const{
+    return m_ranges.size() == 1 && m_ranges[0].isFree();
+}
+void* MemoryBlock::map(VkDevice device){
+    //a memory object can be mapped only once, map the whole block on first use and keep it mapped
+    if (m_mapped_data == nullptr){
+        VkResult result = vkMapMemory(device, m_memory, 0, VK_WHOLE_SIZE, 0, &m_mapped_data);
+        DEBUG_CHECK("Memory mapping", result)
+    }
+    return m_mapped_data;
+}
+void MemoryBlock::destroy(VkDevice device){
+    if (m_mapped_data != nullptr){
+        vkUnmapMemory(device, m_memory);
+        m_mapped_data = nullptr;
+    }
+    vkFreeMemory(device, m_memory, nullptr);
+    m_memory = VK_NULL_HANDLE;
+}
+VkDeviceMemory MemoryBlock::getMemory() const{
+    return m_memory;
+}
+VkDeviceSize MemoryBlock::getSize() const{
+    return m_size;
+}
+bool MemoryBlock::isDedicated() const{
+    return m_dedicated;
+}
+VkDeviceSize MemoryBlock::getUsedSize() const{
+    VkDeviceSize used = 0;
+    for (const MemoryBlockRange& range : m_ranges){
+        if (!range.isFree()) used += range.size;
+    }
+    return used;
+}
+uint32_t MemoryBlock::getAllocationCount() const{
+    uint32_t count = 0;
+    for (const MemoryBlockRange& range : m_ranges){
+        if (!range.isFree()) count++;
+    }
+    return count;
+}
+VkDeviceSize MemoryBlock::getLargestFreeRange() const{
+    VkDeviceSize largest = 0;
+    for (const MemoryBlockRange& range : m_ranges){
+        if (range.isFree()) largest = std::max(largest, range.size);
+    }
+    return largest;
+}
+bool MemoryBlock::conflicting(MemoryResourceType a, MemoryResourceType b){
+    return a != MEMORY_RESOURCE_FREE && b != MEMORY_RESOURCE_FREE && a != b;
+}
+bool MemoryBlock::samePage(VkDeviceSize a, VkDeviceSize b) const{
+    return (a / m_granularity) == (b / m_granularity);
+}
@@ -0,0 +1,180 @@
+#ifndef MEMORY_BLOCK_H
+#define MEMORY_BLOCK_H
+
+/**
+ * memory_block.h
+ *  - Holds classes used by VulkanAllocator to sub-allocate large blocks of device memory
+ */
+
+
+#include "../00_base/vulkan_base.h"
+
+
+//preferred size of one memory block in bytes, smaller heaps use a fraction of their size instead
+const VkDeviceSize MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+//heaps smaller than this use blocks of (heap size / MEMORY_BLOCK_SMALL_HEAP_DIVISOR)
+const VkDeviceSize MEMORY_BLOCK_SMALL_HEAP_SIZE = 1024 * 1024 * 1024;
+const VkDeviceSize MEMORY_BLOCK_SMALL_HEAP_DIVISOR = 8;
+
+
+/**
+ * MemoryResourceType
+ *  - What kind of resource occupies a range of memory. Linear and optimal resources placed next to each other must be separated by bufferImageGranularity
+ */
+enum MemoryResourceType{
+    MEMORY_RESOURCE_FREE,
+    //buffers and linear tiling images
+    MEMORY_RESOURCE_LINEAR,
+    //optimal tiling images
+    MEMORY_RESOURCE_OPTIMAL
+};
+
+
+/**
+ * MemoryUsage
+ *  - How memory will be accessed, used to pick the fastest memory type when multiple ones have the required properties
+ */
+enum MemoryUsage{
+    //no hint, only the explicitly specified properties are considered
+    MEMORY_USAGE_UNKNOWN,
+    //resources used only by the GPU - textures, vertex buffers, render targets
+    MEMORY_USAGE_GPU_ONLY,
+    //staging data written once by the CPU, then copied into GPU only memory
+    MEMORY_USAGE_UPLOAD,
+    //data written by the GPU and read by the CPU
+    MEMORY_USAGE_READBACK,
+    //data rewritten by the CPU every frame and read directly by the GPU, e.g. uniform buffers
+    MEMORY_USAGE_FREQUENT_UPDATE
+};
+
+
+/**
+ * MemoryTypeRequest
+ *  - Describes which memory type an allocation should use. Every type with the required properties and none of the forbidden ones is scored, the best one is used
+ */
+class MemoryTypeRequest{
+public:
+    //the type must have all of these
+    VkMemoryPropertyFlags required;
+    //types with more of these are picked first
+    VkMemoryPropertyFlags preferred;
+    //the type must have none of these
+    VkMemoryPropertyFlags forbidden;
+    MemoryUsage usage;
+
+    //request a type with given properties. When passing just required flags, the first type with them is selected, except protected and lazily allocated types.
+    //With preferred flags or a usage, types with fewer unrequested properties win ties
+    MemoryTypeRequest(VkMemoryPropertyFlags required_ = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VkMemoryPropertyFlags preferred_ = 0,
+        VkMemoryPropertyFlags forbidden_ = 0, MemoryUsage usage_ = MEMORY_USAGE_UNKNOWN);
+
+    /**
+     * Request a type suitable for given usage.
+     *  - GPU only memory prefers device local types without host access
+     *  - upload and frequently updated memory has to be host visible, prefers coherent memory, and device local memory if it is host visible as well
+     *  - readback memory has to be host visible, prefers cached and coherent memory
+     */
+    MemoryTypeRequest(MemoryUsage usage_);
+
+    //return how well a type with given properties fits the request, the higher the better, negative if it can't be used at all
+    int score(VkMemoryPropertyFlags type_properties) const;
+};
+
+
+/**
+ * MemoryAllocation
+ *  - Describes one range of device memory returned by VulkanAllocator::allocateMemory
+ */
+class MemoryAllocation{
+public:
+    //the memory block the range lies in
+    VkDeviceMemory memory;
+    //offset of the range from the block start
+    VkDeviceSize offset;
+    //size of the range in bytes
+    VkDeviceSize size;
+    //index of memory type the block was allocated from
+    uint32_t memory_type;
+
+    //create an invalid allocation
+    MemoryAllocation();
+    MemoryAllocation(VkDeviceMemory memory_, VkDeviceSize offset_, VkDeviceSize size_, uint32_t memory_type_);
+
+    //return (memory != VK_NULL_HANDLE)
+    bool valid() const;
+};
+
+
+/**
+ * MemoryBlockRange
+ *  - One continuous range inside a memory block, either free or occupied by a resource
+ */
+class MemoryBlockRange{
+public:
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    MemoryResourceType type;
+
+    MemoryBlockRange(VkDeviceSize offset_, VkDeviceSize size_, MemoryResourceType type_);
+    //offset of first byte after the range
+    VkDeviceSize end() const;
+    bool isFree() const;
+};
+
+
+/**
+ * MemoryBlock
+ *  - Manages one VkDeviceMemory allocation and places sub-allocations inside it
+ *  - Ranges are kept sorted by offset and always cover the whole block, two free ranges are never next to each other
+ */
+class MemoryBlock{
+    VkDeviceMemory m_memory;
+    VkDeviceSize m_size;
+    //linear and optimal resources may not share a page of this size
+    VkDeviceSize m_granularity;
+    //pointer to the start of the block if it has been mapped, nullptr otherwise
+    void* m_mapped_data;
+    //true if the block was allocated for one resource only, nothing else may be placed into it
+    bool m_dedicated;
+    vector<MemoryBlockRange> m_ranges;
+public:
+    MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, VkDeviceSize buffer_image_granularity, bool dedicated = false);
+
+    /**
+     * Find a free range for a resource and mark it as used. Returns true on success, false if the block doesn't have enough space.
+     * @param size size of the resource in bytes
+     * @param alignment required alignment of the resource offset
+     * @param type what kind of resource will be bound to the range
+     * @param offset is set to the offset of the reserved range if allocation succeeds
+     */
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, MemoryResourceType type, VkDeviceSize& offset);
+
+    //Mark range starting at given offset as free, merge it with neighbouring free ranges
+    void free(VkDeviceSize offset);
+
+    //return true if no ranges are used
+    bool empty() const;
+
+    //Map the whole block if it isn't mapped yet, return pointer to its' start
+    void* map(VkDevice device);
+
+    //Unmap the block (if mapped) and free its' memory
+    void destroy(VkDevice device);
+
+    VkDeviceMemory getMemory() const;
+    VkDeviceSize getSize() const;
+    bool isDedicated() const;
+    //return sum of sizes of all used ranges
+    VkDeviceSize getUsedSize() const;
+    //return how many ranges are used
+    uint32_t getAllocationCount() const;
+    //return size of the largest free range, the largest resource that could fit into the block without alignment
+    VkDeviceSize getLargestFreeRange() const;
+private:
+    //return true if resources of both types can't share one granularity page
+    static bool conflicting(MemoryResourceType a, MemoryResourceType b);
+    //return true if both offsets lie on the same granularity page
+    bool samePage(VkDeviceSize a, VkDeviceSize b) const;
+};
+
+
+#endif
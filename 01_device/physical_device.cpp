@@ -114,7 +114,9 @@ PhysicalDevice& PhysicalDevice::requestQueues(const vector<QueueRequestInfo>& qu
     
     //go through all requested queues
     for (const QueueRequestInfo& request : queues){
-        bool found = false;
+        //index of the family picked for this request, and the number of capabilities it has on top of the requested ones
+        uint32_t picked_family = queue_family_count;
+        uint32_t picked_extra_capabilities = 0;
         //go through all queue families
         for (uint32_t queue_family_index = 0; queue_family_index < queue_family_properties.size(); queue_family_index++){
             //is m_usable_families.size() != 0, it is implied that some queue families are unusable due to factors not taken into account by this function
@@ -124,27 +126,34 @@ PhysicalDevice& PhysicalDevice::requestQueues(const vector<QueueRequestInfo>& qu
             if (queue_family_properties[queue_family_index].queueFlags & request.usage){
                 //if there are enough queues in a given family
                 if (queue_family_properties[queue_family_index].queueCount >= request.count){
-                    //this request can be satisfied, compatible queues found
-                    found = true;
-                    //queue priorities specify how important the work in the given queue is, by default, these are all specified as 0.5f
-                    m_queue_priorities.push_back(vector<float>(request.count, 0.5f));
-                    //fill queue create info structure
-                    VkDeviceQueueCreateInfo info{
-                        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,
-                        queue_family_index, request.count, m_queue_priorities.back().data()
-                    };
-                    //subtract currently reserved queue count from the family it was taken from
-                    queue_family_properties[queue_family_index].queueCount -= request.count;
-                    //save queue create info
-                    m_queue_infos.push_back(info);
-                    break;
+                    //count capabilities the request doesn't need, a family with less of them is more specialized
+                    uint32_t extra_capabilities = 0;
+                    for (VkQueueFlags extra = queue_family_properties[queue_family_index].queueFlags & ~request.usage; extra != 0; extra &= extra - 1) extra_capabilities++;
+                    //pick the first compatible family, or a more specialized one if dedicated queues are preferred
+                    if (picked_family == queue_family_count || extra_capabilities < picked_extra_capabilities){
+                        picked_family = queue_family_index;
+                        picked_extra_capabilities = extra_capabilities;
+                    }
+                    if (!request.prefer_dedicated) break;
                 }
             }
         }
         //if queue of given properties isn't available, print error
-        if (!found){
+        if (picked_family == queue_family_count){
             PRINT_ERROR("Requested queues are not available")
+            continue;
         }
+        //queue priorities specify how important the work in the given queue is, by default, these are all specified as 0.5f
+        m_queue_priorities.push_back(vector<float>(request.count, 0.5f));
+        //fill queue create info structure
+        VkDeviceQueueCreateInfo info{
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr, 0,
+            picked_family, request.count, m_queue_priorities.back().data()
+        };
+        //subtract currently reserved queue count from the family it was taken from
+        queue_family_properties[picked_family].queueCount -= request.count;
+        //save queue create info
+        m_queue_infos.push_back(info);
     }
     return *this;
 }
@@ -214,4 +223,17 @@ PhysicalDevice PhysicalDevices::choose(){
         cin >> index;
         return PhysicalDevice(m_devices[index]);
     }
-}
\ No newline at end of file
+}
+PhysicalDevice PhysicalDevices::choose(const string& name_part){
+    VkPhysicalDeviceProperties properties;
+    //go through all devices, return the first one with matching name
+    for (VkPhysicalDevice device : m_devices){
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (string(properties.deviceName).find(name_part) != string::npos){
+            PRINT_WARN("Using vulkan device: " << properties.deviceName)
+            return PhysicalDevice(device);
+        }
+    }
+    PRINT_ERROR("No vulkan device with name containing '" << name_part << "' found")
+    throw std::runtime_error("No matching vulkan device found.");
+}
@@ -93,6 +93,8 @@ public:
 struct QueueRequestInfo{
     uint32_t count;
     VkQueueFlags usage;
+    //if true, the family with the least capabilities other than usage is picked, e.g. a transfer-only family for VK_QUEUE_TRANSFER_BIT. Otherwise the first compatible family is used
+    bool prefer_dedicated = false;
 };
 
 /**
@@ -155,6 +157,13 @@ public:
      *  - if there are more, let the user choose by typing a number into std::cin
      */ 
     PhysicalDevice choose();
+
+    /**
+     * Pick the first device whose name contains given string, without asking the user. Used when running unattended, e.g. "llvmpipe" picks the Mesa lavapipe software renderer for headless runs
+     *  - if there is no such device, print error
+     * @param name_part part of the device name to look for
+     */
+    PhysicalDevice choose(const string& name_part);
 };
 
 #endif
\ No newline at end of file
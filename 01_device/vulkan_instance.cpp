@@ -63,8 +63,8 @@ VkInstance VulkanInstanceCreateInfo::create() const{
 
 
 VulkanLibrary::VulkanLibrary(){
-    //load library dll
-    m_library = LoadLibrary("vulkan-1.dll");
+    //load library - dll on windows, shared object on linux
+    m_library = loadVulkanLibrary();
     DEBUG_PRINT_INV("Load vulkan library", m_library);
     //load global vulkan functions
     int result = loadVulkanFunctions(m_library);
@@ -86,7 +86,7 @@ VulkanLibrary::~VulkanLibrary(){
     }
     //if library was loaded, free it
     if (m_library){
-        FreeLibrary(m_library);
+        freeVulkanLibrary(m_library);
         m_library = nullptr;
     }
 }
@@ -111,13 +111,13 @@ Device& VulkanInstance::createLogicalDevice(const VkDeviceCreateInfo& device_cre
 
     //create logical device object using created handle
     DEBUG_CHECK("Device was already created", m_logical_device)
-    m_logical_device = new Device(device, physical_device, queue_infos);
+    m_logical_device = new Device(device, physical_device, queue_infos, extensions);
     return *m_logical_device;
 }
-Window& VulkanInstance::createWindow(uint32_t screen_width, uint32_t screen_height, const string& window_name){
+Window& VulkanInstance::createWindow(uint32_t screen_width, uint32_t screen_height, const string& window_name, bool resizable){
     //create window with given parameters
     DEBUG_CHECK("Window was already created", m_window)
-    m_window = new Window(m_instance, screen_width, screen_height, window_name);
+    m_window = new Window(m_instance, screen_width, screen_height, window_name, resizable);
     return *m_window;
 }
 const VkInstance& VulkanInstance::get() {return m_instance;}
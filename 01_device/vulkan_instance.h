@@ -48,12 +48,12 @@ public:
 
 /**
  * VulkanLibrary
- *  - Loads library from dll and loads all global level functions
+ *  - Loads the vulkan loader library (vulkan-1.dll on windows, libvulkan.so.1 on linux) and loads all global level functions
  *  - Is responsible for deleting the created instance
  */
 class VulkanLibrary
 {
-    HMODULE m_library;
+    LibraryHandle m_library;
     VulkanInstance* m_instance = nullptr;
 public:
     //load library and global functions
@@ -87,7 +87,7 @@ public:
     //Create logical device with this instance
     Device& createLogicalDevice(const VkDeviceCreateInfo& device_create_info, VkPhysicalDevice physical_device, const vector<VkDeviceQueueCreateInfo>& queue_infos, const vector<const char*>& extensions);
     //Create a new window with this instance
-    Window& createWindow(uint32_t screen_width, uint32_t screen_height, const string& window_name);
+    Window& createWindow(uint32_t screen_width, uint32_t screen_height, const string& window_name, bool resizable = false);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "frame_pacer.h"
+#include <algorithm>
+#include <thread>
+
+
+//weight of a new sample in moving averages, about the last 20 frames contribute
+const double FRAME_PACER_SMOOTHING = 0.05;
+
+
+FramePacer::FramePacer(nanoseconds target_frame_time) :
+    m_target_frame_time(target_frame_time)
+{
+    reset();
+}
+void FramePacer::setTargetFrameTime(nanoseconds target_frame_time){
+    m_target_frame_time = target_frame_time;
+}
+void FramePacer::waitForNextFrame(){
+    clock::time_point now = clock::now();
+    if (m_target_frame_time != 0 && m_frame_count != 0){
+        clock::time_point next_start = m_last_frame_start + std::chrono::nanoseconds(m_target_frame_time);
+        if (now < next_start){
+            std::this_thread::sleep_until(next_start);
+            //follow the target cadence exactly, so that sleep inaccuracy doesn't accumulate
+            m_last_frame_start = next_start;
+            return;
+        }
+    }
+    m_last_frame_start = now;
+}
+void FramePacer::onAcquire(uint32_t image_index){
+    if (image_index >= m_acquire_times.size()) m_acquire_times.resize(image_index + 1);
+    m_acquire_times[image_index] = clock::now();
+}
+void FramePacer::onPresent(uint32_t image_index){
+    clock::time_point now = clock::now();
+    if (image_index < m_acquire_times.size()){
+        m_last_latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_acquire_times[image_index]).count();
+        m_average_latency = (m_frame_count == 0) ? m_last_latency : m_average_latency + FRAME_PACER_SMOOTHING * (m_last_latency - m_average_latency);
+        m_max_latency = std::max(m_max_latency, m_last_latency);
+    }
+    //frame time can be measured only from the second frame
+    if (m_frame_count != 0){
+        double frame_time = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last_present).count();
+        m_average_frame_time = (m_frame_count == 1) ? frame_time : m_average_frame_time + FRAME_PACER_SMOOTHING * (frame_time - m_average_frame_time);
+    }
+    m_last_present = now;
+    m_frame_count++;
+}
+nanoseconds FramePacer::getLastLatency() const{
+    return m_last_latency;
+}
+nanoseconds FramePacer::getAverageLatency() const{
+    return (nanoseconds) m_average_latency;
+}
+nanoseconds FramePacer::getMaxLatency() const{
+    return m_max_latency;
+}
+nanoseconds FramePacer::getAverageFrameTime() const{
+    return (nanoseconds) m_average_frame_time;
+}
+uint64_t FramePacer::getFrameCount() const{
+    return m_frame_count;
+}
+void FramePacer::reset(){
+    m_acquire_times.clear();
+    m_last_present = clock::time_point{};
+    m_last_frame_start = clock::time_point{};
+    m_frame_count = 0;
+    m_last_latency = 0;
+    m_average_latency = 0;
+    m_max_latency = 0;
+    m_average_frame_time = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+
+/**
+ * frame_pacer.h
+ *  - FramePacer class, measures acquire-to-present latency and frame times and can limit the frame rate
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "../03_commands/synchronization.h"
+#include <chrono>
+
+
+/**
+ * FramePacer
+ *  - Measures time between acquiring a swapchain image and presenting it, and time between successive presents
+ *  - Latency is measured on the CPU, it is the time spent recording and submitting a frame. Time the image spends queued for display
+ *    depends on the present mode and image count (see SwapchainInfo::setPresentPolicy)
+ *  - With a target frame time set, waitForNextFrame() sleeps so that frames don't start sooner than the display can show them,
+ *    input is then read as late as possible and fewer frames wait in the queue
+ */
+class FramePacer{
+    using clock = std::chrono::steady_clock;
+    //minimum time between frame starts, 0 if frames aren't paced
+    nanoseconds m_target_frame_time;
+    //when each swapchain image was acquired, indexed by image index
+    vector<clock::time_point> m_acquire_times;
+    clock::time_point m_last_present;
+    clock::time_point m_last_frame_start;
+    uint64_t m_frame_count;
+    //last measured values and their exponential moving averages
+    nanoseconds m_last_latency;
+    double m_average_latency;
+    nanoseconds m_max_latency;
+    double m_average_frame_time;
+public:
+    //Create a pacer, target_frame_time of 0 disables pacing, e.g. SYNC_FRAME paces to 60 FPS
+    FramePacer(nanoseconds target_frame_time = 0);
+
+    //Set minimum time between frame starts, 0 disables pacing
+    void setTargetFrameTime(nanoseconds target_frame_time);
+
+    //Sleep until the next frame should start, returns immediately if pacing is disabled or the frame is already late
+    void waitForNextFrame();
+
+    //Record that image with given index was acquired
+    void onAcquire(uint32_t image_index);
+
+    //Record that image with given index was presented, update latency and frame time statistics
+    void onPresent(uint32_t image_index);
+
+    //Get latency of the last presented frame
+    nanoseconds getLastLatency() const;
+    //Get moving average of acquire-to-present latency
+    nanoseconds getAverageLatency() const;
+    //Get maximum latency since creation or last reset
+    nanoseconds getMaxLatency() const;
+    //Get moving average of time between presents
+    nanoseconds getAverageFrameTime() const;
+    //Get number of presented frames
+    uint64_t getFrameCount() const;
+
+    //Forget all statistics
+    void reset();
+};
+
+
+#endif
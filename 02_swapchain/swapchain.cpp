@@ -1,6 +1,8 @@
 #include "swapchain.h"
 #include "../01_device/device.h"
 #include "../06_render_passes/framebuffer.h"
+#include "window.h"
+#include <algorithm>
 
 SwapchainImage::SwapchainImage() : Image{}, m_image_index(IMAGE_INDEX_INVALID)
 {}
@@ -19,18 +21,12 @@ VkFramebuffer SwapchainImage::getFramebuffer() const{
 }
 
 
-Swapchain::Swapchain(VkSwapchainKHR swapchain, const ImageInfo& image_info) :
-    m_swapchain(swapchain), m_device(g_device), m_swapchain_image_info(image_info)
+Swapchain::Swapchain(VkSwapchainKHR swapchain, const VkSwapchainCreateInfoKHR& create_info) :
+    m_swapchain(swapchain), m_device(g_device), m_image_acquire_pending(false),
+    m_swapchain_image_info(create_info.imageExtent.width, create_info.imageExtent.height, create_info.imageFormat, create_info.imageUsage),
+    m_create_info(create_info), m_render_pass(VK_NULL_HANDLE), m_depth_attachment(VK_NULL_HANDLE), m_layer_count(1), m_needs_recreation(false)
 {
-    //get actual swapchain image count - this can be larger than count specified by swapchainInfo
-    uint32_t swapchain_image_count;
-    VkResult result = vkGetSwapchainImagesKHR(m_device, m_swapchain, &swapchain_image_count, nullptr);
-    DEBUG_CHECK("Get swapchain image count", result)
-
-    //retrieve all swapchain images
-    m_images.resize(swapchain_image_count, VK_NULL_HANDLE);
-    result = vkGetSwapchainImagesKHR(m_device, m_swapchain, &swapchain_image_count, m_images.data());
-    DEBUG_CHECK("Get swapchain images", result);
+    getImages();
 }
 
 SwapchainImage Swapchain::acquireImage(){
@@ -40,20 +36,42 @@ SwapchainImage Swapchain::acquireImage(){
     //m_image_acquire_fence.reset();
     //wait 10us for image to be available, if none is 
     VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, SYNC_10US, VK_NULL_HANDLE, m_image_acquire_fence, &image_index);
-    //if image was succesfully returned, return it
+    //if image was succesfully returned, return it. A suboptimal image can still be presented, but the swapchain should be recreated soon
     if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR){
-        return SwapchainImage{Image{m_images[image_index], m_swapchain_image_info}, m_framebuffers[image_index], image_index};
+        if (result == VK_SUBOPTIMAL_KHR) m_needs_recreation = true;
+        m_image_acquire_pending = true;
+        m_pacer.onAcquire(image_index);
+        return SwapchainImage{Image{m_images[image_index], m_swapchain_image_info}, m_framebuffers.empty() ? VK_NULL_HANDLE : m_framebuffers[image_index], image_index};
     }
-    //sometimes swapchain can break and invalidate all images. I don't know the conditions under which it happens, so there is no protection against it.
+    //the surface changed (e.g. the window was resized) and the swapchain can't be used anymore, it has to be recreated
     else if (result == VK_ERROR_OUT_OF_DATE_KHR){
-        PRINT_ERROR("Have to create new swapchain. This one is broken")
-        throw std::runtime_error("Swapchain broken (VK_ERROR_OUT_OF_DATE_KHR)");
+        m_needs_recreation = true;
+        return SwapchainImage{};
     }
     //if no images are ready yet
     PRINT_WARN("No image is ready to be acquired")
     return SwapchainImage{};
 }
+SwapchainImage Swapchain::acquireImage(VkSemaphore signal_semaphore, nanoseconds timeout){
+    uint32_t image_index;
+    //no fence is used, the GPU waits for the semaphore instead of the CPU waiting for the image
+    VkResult result = vkAcquireNextImageKHR(m_device, m_swapchain, timeout, signal_semaphore, VK_NULL_HANDLE, &image_index);
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR){
+        if (result == VK_SUBOPTIMAL_KHR) m_needs_recreation = true;
+        m_pacer.onAcquire(image_index);
+        return SwapchainImage{Image{m_images[image_index], m_swapchain_image_info}, m_framebuffers.empty() ? VK_NULL_HANDLE : m_framebuffers[image_index], image_index};
+    }
+    else if (result == VK_ERROR_OUT_OF_DATE_KHR){
+        m_needs_recreation = true;
+        return SwapchainImage{};
+    }
+    PRINT_WARN("No image is ready to be acquired")
+    return SwapchainImage{};
+}
 void Swapchain::prepareToDraw(){
+    //the fence isn't signaled if no image was acquired, e.g. because the swapchain is out of date
+    if (!m_image_acquire_pending) return;
+    m_image_acquire_pending = false;
     if (m_image_acquire_fence.waitFor(SYNC_FRAME)){
         m_image_acquire_fence.reset();
     }else{
@@ -67,21 +85,86 @@ void Swapchain::presentImage(const SwapchainImage& img, const Queue& queue){
 
     //send the given image to be displayed
     VkResult result = vkQueuePresentKHR(queue, &present_info);
-    DEBUG_CHECK("Present image", result)
+    m_pacer.onPresent(index);
+    //the image was still presented if the swapchain is suboptimal, recreate it before the next frame
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) m_needs_recreation = true;
+    else DEBUG_CHECK("Present image", result)
+}
+void Swapchain::presentImage(const SwapchainImage& img, const Queue& queue, VkSemaphore wait_semaphore){
+    uint32_t index = img.getIndex();
+    VkPresentInfoKHR present_info{VK_STRUCTURE_TYPE_PRESENT_INFO_KHR, nullptr, 1, &wait_semaphore, 1, &m_swapchain, &index, nullptr};
+    VkResult result = vkQueuePresentKHR(queue, &present_info);
+    m_pacer.onPresent(index);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) m_needs_recreation = true;
+    else DEBUG_CHECK("Present image", result)
 }
 void Swapchain::createFramebuffers(VkRenderPass render_pass, VkImageView depth_attachment, uint32_t layer_count){
+    //remember parameters, so that framebuffers can be rebuilt when the swapchain is recreated
+    m_render_pass = render_pass;
+    m_depth_attachment = depth_attachment;
+    m_layer_count = layer_count;
+    //previous framebuffers can still be used by frames in flight
+    for (VkFramebuffer framebuffer : m_framebuffers) g_allocator.get().releaseFramebuffer(framebuffer);
+    //create views only once, framebuffers can be created again for a different render pass
+    if (m_views.empty()){
+        for (VkImage image : m_images){
+            m_views.push_back(Image{image, m_swapchain_image_info}.createView());
+        }
+    }
     //allocate space for the framebuffers
     m_framebuffers.resize(m_images.size(), VK_NULL_HANDLE);
     //go through all images
     for (uint32_t i = 0; i < m_images.size(); i++){
-        //create image view for the given image
-        VkImageView color_attachment = Image{m_images[i], m_swapchain_image_info}.createView();
-        
         //create framebuffer for the given image and save it
         m_framebuffers[i] = FramebufferInfo(getWidth(), getHeight(),
-            depth_attachment == VK_NULL_HANDLE ? vector<VkImageView>{color_attachment} : vector<VkImageView>{color_attachment, depth_attachment},
+            depth_attachment == VK_NULL_HANDLE ? vector<VkImageView>{m_views[i]} : vector<VkImageView>{m_views[i], depth_attachment},
             render_pass).setLayerCount(layer_count).create();
-        }
+    }
+}
+FramePacer& Swapchain::getPacer(){
+    return m_pacer;
+}
+bool Swapchain::needsRecreation() const{
+    return m_needs_recreation;
+}
+bool Swapchain::recreate(Window& window){
+    VkSurfaceCapabilitiesKHR capabilities;
+    VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(g_allocator.get().getPhysicalDevice(), m_create_info.surface, &capabilities);
+    DEBUG_CHECK("Get surface capabilities", result)
+    //the surface either defines the extent, or lets the swapchain decide it, then the framebuffer size of the window is used
+    VkExtent2D extent = capabilities.currentExtent;
+    if (extent.width == 0xFFFFFFFF){
+        extent = window.getFramebufferExtent();
+        extent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, extent.width));
+        extent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, extent.height));
+    }
+    //minimized window, a swapchain with zero size can't be created
+    if (extent.width == 0 || extent.height == 0) return false;
+
+    //create the new swapchain, the old one can still present images that were already acquired
+    m_create_info.imageExtent = extent;
+    m_create_info.oldSwapchain = m_swapchain;
+    VkSwapchainKHR new_swapchain = g_allocator.get().createSwapchain(m_create_info);
+    m_create_info.oldSwapchain = VK_NULL_HANDLE;
+
+    //images of the old swapchain can still be used by frames in flight, destroy it with its' views and framebuffers once they finish
+    for (VkFramebuffer framebuffer : m_framebuffers) g_allocator.get().releaseFramebuffer(framebuffer);
+    for (VkImageView view : m_views) g_allocator.get().releaseImageView(view);
+    g_allocator.get().releaseSwapchain(m_swapchain);
+    m_framebuffers.clear();
+    m_views.clear();
+
+    m_swapchain = new_swapchain;
+    m_swapchain_image_info = ImageInfo(extent.width, extent.height, m_create_info.imageFormat, m_create_info.imageUsage);
+    getImages();
+    m_needs_recreation = false;
+    window.setSize(extent);
+
+    //the depth attachment has the old size, the application has to create a new one and call createFramebuffers itself
+    if (m_render_pass != VK_NULL_HANDLE && m_depth_attachment == VK_NULL_HANDLE){
+        createFramebuffers(m_render_pass, VK_NULL_HANDLE, m_layer_count);
+    }
+    return true;
 }
 uint32_t Swapchain::getWidth() const
 {
@@ -95,3 +178,14 @@ VkFormat Swapchain::getFormat() const
 {
     return m_swapchain_image_info.get().format;
 }
+void Swapchain::getImages(){
+    //get actual swapchain image count - this can be larger than count specified by swapchainInfo
+    uint32_t swapchain_image_count;
+    VkResult result = vkGetSwapchainImagesKHR(m_device, m_swapchain, &swapchain_image_count, nullptr);
+    DEBUG_CHECK("Get swapchain image count", result)
+
+    //retrieve all swapchain images
+    m_images.resize(swapchain_image_count, VK_NULL_HANDLE);
+    result = vkGetSwapchainImagesKHR(m_device, m_swapchain, &swapchain_image_count, m_images.data());
+    DEBUG_CHECK("Get swapchain images", result);
+}
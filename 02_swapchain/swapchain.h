@@ -11,6 +11,7 @@
 #include "../00_base/vulkan_base.h"
 #include "../03_commands/synchronization.h"
 #include "../04_memory_objects/image_info.h"
+#include "frame_pacer.h"
 
 
 
@@ -35,38 +36,83 @@ public:
 
 
 class Queue;
+class Window;
 /**
  * Swapchain
  *  - Holds one swapchain
+ *  - When the window is resized, acquiring or presenting marks the swapchain as out of date instead of failing, the application then calls recreate()
  */
 class Swapchain{
     VkSwapchainKHR m_swapchain;
     VkDevice m_device;
     //fence for which to wait when acquiring images
     Fence m_image_acquire_fence;
-    //vector of all images and their framebuffers
+    //true if the last acquire without a semaphore succeeded, the fence is signaled only then and prepareToDraw() waits for it
+    bool m_image_acquire_pending;
+    //vector of all images, their views and framebuffers
     vector<VkImage> m_images;
+    vector<VkImageView> m_views;
     vector<VkFramebuffer> m_framebuffers;
     //information about one images in the swapchain(format, size, ...)
     ImageInfo m_swapchain_image_info;
+    //info the swapchain was created with, used to recreate it
+    VkSwapchainCreateInfoKHR m_create_info;
+    //parameters of the last createFramebuffers call, used to rebuild framebuffers after recreation
+    VkRenderPass m_render_pass;
+    VkImageView m_depth_attachment;
+    uint32_t m_layer_count;
+    //true if the swapchain doesn't match the surface anymore, it should be recreated
+    bool m_needs_recreation;
+    //measures latency between acquiring and presenting each image
+    FramePacer m_pacer;
 public:
     //Set m_swapchain handle and get all swapchain images into 
-    Swapchain(VkSwapchainKHR swapchain, const ImageInfo& image_info);
+    Swapchain(VkSwapchainKHR swapchain, const VkSwapchainCreateInfoKHR& create_info);
 
     //Acquire an image to draw into. By default, all images represented by handles in swapchain are under vulkan's control, this makes vulkan turn one of them over to the program.
     SwapchainImage acquireImage();
 
+    /**
+     * Acquire an image to draw into, without blocking the CPU until it is ready. The semaphore is signaled once the presentation engine stops reading the image,
+     * the first submit writing into the image has to wait for it. Returns an invalid image if none could be acquired inside the timeout.
+     * @param signal_semaphore semaphore to signal when the image can be written to
+     * @param timeout how long to wait for an image index in nanoseconds
+     */
+    SwapchainImage acquireImage(VkSemaphore signal_semaphore, nanoseconds timeout = A_SHORT_WHILE);
+
+    //Wait until the image acquired by acquireImage() without a semaphore can be written to. Does nothing if the acquire failed
     void prepareToDraw();
 
     //Use given queue to present given image to the screen. Queue must support image presentation.
     void presentImage(const SwapchainImage& img, const Queue& queue);
 
-    //Create framebuffers for all swapchain images, using given render_pass and depth attachment, if needed
+    //Present given image once the semaphore is signaled, e.g. when rendering into the image finishes. Queue must support image presentation.
+    void presentImage(const SwapchainImage& img, const Queue& queue, VkSemaphore wait_semaphore);
+
+    //Create framebuffers for all swapchain images, using given render_pass and depth attachment, if needed. Previous framebuffers are released after the current frame
     void createFramebuffers(VkRenderPass render_pass, VkImageView depth_attachment = VK_NULL_HANDLE, uint32_t layer_count = 1);
 
+    //Return true if acquiring or presenting reported that the swapchain is out of date or suboptimal
+    bool needsRecreation() const;
+
+    /**
+     * Recreate the swapchain with the current window size, passing the old one as oldSwapchain. The window size is updated to the new extent. The old swapchain, its' views and framebuffers
+     * are released and destroyed once frames in flight finish (see VulkanAllocator::endFrame). Framebuffers without a depth attachment are rebuilt automatically,
+     * otherwise createFramebuffers has to be called with a depth image of the new size.
+     * Return false if the window is minimized - there is nothing to draw into, recreation should be tried again later.
+     * @param window the window the swapchain presents to
+     */
+    bool recreate(Window& window);
+
+    //Get the frame pacer, it holds acquire-to-present latency and frame time statistics and can limit the frame rate
+    FramePacer& getPacer();
+
     uint32_t getWidth() const;
     uint32_t getHeight() const;
     VkFormat getFormat() const;
+private:
+    //Get handles of all swapchain images
+    void getImages();
 };
 
 
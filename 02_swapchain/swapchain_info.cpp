@@ -2,6 +2,7 @@
 
 #include "../01_device/allocator.h"
 #include "window.h"
+#include <algorithm>
 
 SwapchainInfo::SwapchainInfo(VkPhysicalDevice device, Window& window) : 
     m_device(device), m_surface(window.getSurface()),
@@ -16,18 +17,8 @@ SwapchainInfo::SwapchainInfo(VkPhysicalDevice device, Window& window) :
     DEBUG_CHECK("Get surface capabilities", result)
 }
 SwapchainInfo& SwapchainInfo::setPresentMode(VkPresentModeKHR desired_present_mode){
-    //get swapchain present mode count
-    uint32_t present_modes_count;
-    VkResult result = vkGetPhysicalDeviceSurfacePresentModesKHR(m_device, m_surface, &present_modes_count, nullptr);
-    DEBUG_CHECK("Could not get device present modes count", result)
-
-    //get swapchain present modes
-    vector<VkPresentModeKHR> present_modes(present_modes_count);
-    result = vkGetPhysicalDeviceSurfacePresentModesKHR(m_device, m_surface, &present_modes_count, &present_modes[0]);
-    DEBUG_CHECK("Could not retrieve device present modes", result)
-
     //check if the requested present mode is available, print error if it isn't
-    for (VkPresentModeKHR v : present_modes){
+    for (VkPresentModeKHR v : getPresentModes()){
         if (v == desired_present_mode)
         {
             m_info.presentMode = desired_present_mode;
@@ -37,6 +28,45 @@ SwapchainInfo& SwapchainInfo::setPresentMode(VkPresentModeKHR desired_present_mo
     PRINT_ERROR("The requested present mode was not found")
     return *this;
 }
+SwapchainInfo& SwapchainInfo::setPresentPolicy(PresentPolicy policy){
+    //present modes in order of preference for each policy, FIFO is always supported so the search never fails
+    vector<VkPresentModeKHR> preferred;
+    switch (policy){
+        case PRESENT_POLICY_LOW_LATENCY:
+            preferred = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR};
+            break;
+        case PRESENT_POLICY_VSYNC:
+            preferred = {VK_PRESENT_MODE_FIFO_KHR};
+            break;
+        case PRESENT_POLICY_MAX_THROUGHPUT:
+            preferred = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR};
+            break;
+    }
+    vector<VkPresentModeKHR> available = getPresentModes();
+    VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
+    for (VkPresentModeKHR p : preferred){
+        if (std::find(available.begin(), available.end(), p) != available.end()){
+            mode = p;
+            break;
+        }
+    }
+    if (mode != preferred[0]) PRINT_WARN("Preferred present mode not available, falling back to " << mode)
+    m_info.presentMode = mode;
+
+    uint32_t image_count;
+    if (policy == PRESENT_POLICY_MAX_THROUGHPUT){
+        //two spare images - one being displayed, one queued, the rest can always be rendered into
+        image_count = m_capabilities.minImageCount + 2;
+    }else if (mode == VK_PRESENT_MODE_MAILBOX_KHR || policy == PRESENT_POLICY_VSYNC){
+        //mailbox needs a spare image to replace the queued one, FIFO with one spare image avoids stalls when a frame is late
+        image_count = m_capabilities.minImageCount + 1;
+    }else{
+        //fewest images - frames can't queue up behind the displayed one
+        image_count = m_capabilities.minImageCount;
+    }
+    m_info.minImageCount = clampImageCount(image_count);
+    return *this;
+}
 SwapchainInfo& SwapchainInfo::setSurfaceFormat(VkFormat desired_format, VkColorSpaceKHR color_space)
 {
     //get supported swapchain format count
@@ -83,7 +113,7 @@ SwapchainInfo& SwapchainInfo::setCompositeAlphaMode(VkCompositeAlphaFlagBitsKHR
 }
 SwapchainInfo& SwapchainInfo::setImageCount(uint32_t image_count){
     //if the required image count is within supported bounds, set it, otherwise print error
-    if (image_count >= m_capabilities.minImageCount && image_count <= m_capabilities.maxImageCount) m_info.minImageCount = image_count;
+    if (image_count == clampImageCount(image_count)) m_info.minImageCount = image_count;
     else PRINT_ERROR("Image count out of bounds (" << m_capabilities.minImageCount << ", " << m_capabilities.maxImageCount << ")")
     return *this;
 }
@@ -102,7 +132,27 @@ SwapchainInfo& SwapchainInfo::setTransformation(VkSurfaceTransformFlagBitsKHR de
     else PRINT_ERROR("Requested swapchain transformation not available")
     return *this;
 }
+VkPresentModeKHR SwapchainInfo::getPresentMode() const{
+    return m_info.presentMode;
+}
+vector<VkPresentModeKHR> SwapchainInfo::getPresentModes() const{
+    //get swapchain present mode count
+    uint32_t present_modes_count;
+    VkResult result = vkGetPhysicalDeviceSurfacePresentModesKHR(m_device, m_surface, &present_modes_count, nullptr);
+    DEBUG_CHECK("Could not get device present modes count", result)
+
+    //get swapchain present modes
+    vector<VkPresentModeKHR> present_modes(present_modes_count);
+    result = vkGetPhysicalDeviceSurfacePresentModesKHR(m_device, m_surface, &present_modes_count, present_modes.data());
+    DEBUG_CHECK("Could not retrieve device present modes", result)
+    return present_modes;
+}
+uint32_t SwapchainInfo::clampImageCount(uint32_t image_count) const{
+    image_count = std::max(image_count, m_capabilities.minImageCount);
+    if (m_capabilities.maxImageCount != 0) image_count = std::min(image_count, m_capabilities.maxImageCount);
+    return image_count;
+}
 Swapchain SwapchainInfo::create(){
     //create swapchain with info set before, then return it
-    return Swapchain(g_allocator.get().createSwapchain(m_info), ImageInfo{m_info.imageExtent.width, m_info.imageExtent.height, m_info.imageFormat, m_info.imageUsage});
+    return Swapchain(g_allocator.get().createSwapchain(m_info), m_info);
 }
\ No newline at end of file
@@ -11,6 +11,21 @@
 
 class Window;
 
+
+/**
+ * PresentPolicy
+ *  - What the swapchain is optimized for, used to choose present mode and image count
+ */
+enum PresentPolicy{
+    //show frames as soon as possible, newer frames replace queued ones - MAILBOX, then IMMEDIATE, FIFO_RELAXED and FIFO. Interactive tools
+    PRESENT_POLICY_LOW_LATENCY,
+    //every frame is shown, synchronized with the display - FIFO, always supported
+    PRESENT_POLICY_VSYNC,
+    //never block on presentation, tearing is allowed - IMMEDIATE, then MAILBOX, FIFO_RELAXED and FIFO. Capture and benchmark tools
+    PRESENT_POLICY_MAX_THROUGHPUT
+};
+
+
 /**
  * SwapchainInfo
  *  - holds all information required for creating a swapchain and enables user to set swapchain properties
@@ -39,6 +54,13 @@ public:
      */
     SwapchainInfo& setPresentMode(VkPresentModeKHR mode);
 
+    /**
+     * Choose present mode and image count according to given policy. The first supported mode from the policy's list is used.
+     * Low latency uses the fewest images the mode allows, max throughput adds spare images so that rendering never waits for the display.
+     * @param policy what to optimize for
+     */
+    SwapchainInfo& setPresentPolicy(PresentPolicy policy);
+
     
     /**
      * Check whether given combination of format and color_space is supported, set it if it is
@@ -71,8 +93,16 @@ public:
      */
     SwapchainInfo& setTransformation(VkSurfaceTransformFlagBitsKHR transformation);
 
+    //get the selected present mode
+    VkPresentModeKHR getPresentMode() const;
+
     //create swapchain with given info
     Swapchain create();
+private:
+    //Get all present modes supported by the surface
+    vector<VkPresentModeKHR> getPresentModes() const;
+    //Clamp image count to limits of the surface, max. image count of zero means there is no limit
+    uint32_t clampImageCount(uint32_t image_count) const;
 };
 
 
@@ -1,14 +1,14 @@
 #include "window.h"
 
-Window::Window(const VkInstance instance, uint32_t screen_width, uint32_t screen_height, string title) :
+Window::Window(const VkInstance instance, uint32_t screen_width, uint32_t screen_height, string title, bool resizable) :
     m_width(screen_width), m_height(screen_height), m_vulkan_instance(instance)
 {
     //initialize GLFW
     glfwInit();
     //create no default context, only OpenGL contexts are created this way
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    //window will not be resizable
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    //whether the window can be resized by the user
+    glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
     //create window
     m_window = glfwCreateWindow(m_width, m_height, title.c_str(), nullptr, nullptr);
     //create vulkan surface for the window
@@ -47,10 +47,19 @@ uint32_t Window::getWidth() const{
 uint32_t Window::getHeight() const{
     return m_height;
 }
+VkExtent2D Window::getFramebufferExtent(){
+    int width, height;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    return VkExtent2D{(uint32_t) width, (uint32_t) height};
+}
 glm::vec2 Window::getSize() const
 {
     return {m_width, m_height};
 }
+void Window::setSize(VkExtent2D extent){
+    m_width = extent.width;
+    m_height = extent.height;
+}
 void Window::destroy(){
     //if screen surface was created, destroy it
     if (m_screen_surface){
@@ -17,16 +17,16 @@
  *  - Wrapper around GLFWwindow class, uses GLFW to create and manage window
  */
 class Window{
-    const uint32_t m_width;
-    const uint32_t m_height;
+    uint32_t m_width;
+    uint32_t m_height;
     const VkInstance m_vulkan_instance;
     GLFWwindow* m_window;
     VkSurfaceKHR m_screen_surface = VK_NULL_HANDLE;
     //app is supposed to terminate if this is false
     bool m_running = true;
 public:
-    //Create window and initialize GLFW
-    Window(const VkInstance instance, uint32_t width, uint32_t height, string title);
+    //Create window and initialize GLFW. A resizable window requires the swapchain to be recreated when its' size changes (see Swapchain::recreate)
+    Window(const VkInstance instance, uint32_t width, uint32_t height, string title, bool resizable = false);
 
     //poll events and check whether window shouldn't be closed
     void update();
@@ -48,6 +48,12 @@ public:
     uint32_t getHeight() const;
     glm::vec2 getSize() const;
 
+    //Set the size returned by getWidth(), getHeight() and getSize(), Swapchain::recreate sets it to the new swapchain extent
+    void setSize(VkExtent2D extent);
+
+    //Get the current size of the window framebuffer in pixels, it changes when the window is resized and is zero when it is minimized
+    VkExtent2D getFramebufferExtent();
+
     //destroy window and terminate GLFW
     void destroy();
 };
@@ -0,0 +1,28 @@
+#include "barrier_batch.h"
+
+
+BarrierBatch::BarrierBatch() : m_past_stages(0), m_next_stages(0)
+{}
+void BarrierBatch::add(VkPipelineStageFlags past_stages, VkPipelineStageFlags next_stages, const VkBufferMemoryBarrier& barrier){
+    m_past_stages |= past_stages;
+    m_next_stages |= next_stages;
+    m_buffer_barriers.push_back(barrier);
+}
+void BarrierBatch::add(VkPipelineStageFlags past_stages, VkPipelineStageFlags next_stages, const VkImageMemoryBarrier& barrier){
+    m_past_stages |= past_stages;
+    m_next_stages |= next_stages;
+    m_image_barriers.push_back(barrier);
+}
+bool BarrierBatch::empty() const{
+    return m_buffer_barriers.empty() && m_image_barriers.empty();
+}
+void BarrierBatch::record(CommandBuffer& buffer){
+    if (!empty()) buffer.cmdBarrier(m_past_stages, m_next_stages, m_buffer_barriers, m_image_barriers);
+    clear();
+}
+void BarrierBatch::clear(){
+    m_past_stages = 0;
+    m_next_stages = 0;
+    m_buffer_barriers.clear();
+    m_image_barriers.clear();
+}
@@ -0,0 +1,57 @@
+#ifndef BARRIER_BATCH_H
+#define BARRIER_BATCH_H
+
+/**
+ * barrier_batch.h
+ *  - BarrierBatch class, collects memory barriers and records them using one barrier command
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "command_buffer.h"
+
+
+/**
+ * BarrierBatch
+ *  - Collects buffer and image memory barriers, then records all of them using one vkCmdPipelineBarrier
+ *  - Source and destination stages of all barriers are combined, each barrier waits for all source stages and blocks all destination stages of the batch.
+ *    This may synchronize a bit more than needed, but one barrier command is much cheaper than many small ones
+ *  - Barriers in one batch are executed at once, so they must not depend on each other - e.g. two barriers of the same image can't be in one batch
+ */
+class BarrierBatch{
+    //stages of all barriers added so far
+    VkPipelineStageFlags m_past_stages;
+    VkPipelineStageFlags m_next_stages;
+    vector<VkBufferMemoryBarrier> m_buffer_barriers;
+    vector<VkImageMemoryBarrier> m_image_barriers;
+public:
+    BarrierBatch();
+
+    /**
+     * Add a buffer memory barrier to the batch
+     * @param past_stages the stage that has to be finished for the memory barrier to execute
+     * @param next_stages the stage at which the barrier will wait for past_stages to finish
+     * @param barrier the memory barrier to add
+     */
+    void add(VkPipelineStageFlags past_stages, VkPipelineStageFlags next_stages, const VkBufferMemoryBarrier& barrier);
+
+    /**
+     * Add an image memory barrier to the batch
+     * @param past_stages the stage that has to be finished for the memory barrier to execute
+     * @param next_stages the stage at which the barrier will wait for past_stages to finish
+     * @param barrier the memory barrier to add
+     */
+    void add(VkPipelineStageFlags past_stages, VkPipelineStageFlags next_stages, const VkImageMemoryBarrier& barrier);
+
+    //Return true if there are no barriers in the batch
+    bool empty() const;
+
+    //Record all barriers into given command buffer using one barrier command, then clear the batch
+    void record(CommandBuffer& buffer);
+
+    //Remove all barriers without recording them
+    void clear();
+};
+
+
+#endif
@@ -85,6 +85,12 @@ void CommandBuffer::cmdBarrier(VkPipelineStageFlags past_stages, VkPipelineStage
         0, nullptr,     //no buffer barriers
         memory_barriers.size(), memory_barriers.data());
 }
+void CommandBuffer::cmdBarrier(VkPipelineStageFlags past_stages, VkPipelineStageFlags next_stages, const vector<VkBufferMemoryBarrier>& buffer_memory_barriers, const vector<VkImageMemoryBarrier>& image_memory_barriers){
+    vkCmdPipelineBarrier(m_buffer, past_stages, next_stages, 0,
+        0, nullptr,     //no memory barriers
+        buffer_memory_barriers.size(), buffer_memory_barriers.data(),
+        image_memory_barriers.size(), image_memory_barriers.data());
+}
 void CommandBuffer::cmdCopyFromBuffer(const Buffer& from, const Buffer& to, VkDeviceSize size, VkDeviceSize from_offset, VkDeviceSize to_offset){
     //if the whole size should be copied, get actual size from source buffer
     if (size == VK_WHOLE_SIZE) size = from.getSize();
@@ -97,23 +103,52 @@ void CommandBuffer::cmdCopyFromBuffer(const Buffer& from, const Buffer& to, VkDe
     VkBufferCopy copy{from_offset, to_offset, size};
     vkCmdCopyBuffer(m_buffer, from, to, 1, &copy);
 }
-void CommandBuffer::cmdCopyToTexture(const Buffer& from, Image& texture, ImageState state, ImageState end_state)
+void CommandBuffer::cmdCopyToTexture(const Buffer& from, Image& texture, ImageState state, ImageState end_state, VkDeviceSize buffer_offset)
 {
     ImageState transfer_state = ImageState(IMAGE_TRANSFER_DST);
     //if the image isn't in the correct layout already, record a memory barrier to change the layout
     if (state != transfer_state){
         cmdBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, texture.createMemoryBarrier(state, ImageState(IMAGE_TRANSFER_DST)));
     }
+    //copy the whole image
+    cmdCopyToTextureRegion(from, texture, buffer_offset, VkOffset3D{0, 0, 0}, texture.getSize());
+    //if layout needs to be transitioned after end, record the layout transition
+    if (end_state != transfer_state){
+        cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, texture.createMemoryBarrier(transfer_state, end_state));
+    }
+}
+void CommandBuffer::cmdCopyToTextureRegion(const Buffer& from, Image& texture, VkDeviceSize buffer_offset, VkOffset3D image_offset, VkExtent3D extent, uint32_t mip_level, uint32_t array_layer){
     //values - buffer offset, buffer_row_length(0 for tightly packed), buffer_image_height(0 for tightly packed)
     // - VkImageSubresourceLayers - aspect, mipmap level to copy to, base array layer to copy to, number of layers to copy to
     // - VkOffset3D - offset in image to copy into
     // - size of image volume to copy into
-    VkBufferImageCopy copy{0, 0, 0, VkImageSubresourceLayers{texture.getAspect(), 0, 0, 1}, VkOffset3D{0, 0, 0}, texture.getSize()};
-    vkCmdCopyBufferToImage(m_buffer, from, texture, state.layout, 1, &copy);
-    //if layout needs to be transitioned after end, record the layout transition
+    VkBufferImageCopy copy{buffer_offset, 0, 0, VkImageSubresourceLayers{texture.getAspect(), mip_level, array_layer, 1}, image_offset, extent};
+    vkCmdCopyBufferToImage(m_buffer, from, texture, ImageState(IMAGE_TRANSFER_DST).layout, 1, &copy);
+}
+void CommandBuffer::cmdCopyFromTexture(Image& texture, ImageState state, ImageState end_state, const Buffer& to, VkDeviceSize buffer_offset){
+    ImageState transfer_state = ImageState(IMAGE_TRANSFER_SRC);
+    //wait for all previous writes to the image and move it to transfer layout
+    if (state != transfer_state){
+        cmdBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, texture.createMemoryBarrier(state, transfer_state));
+    }
+    //copy the whole image, tightly packed
+    VkBufferImageCopy copy{buffer_offset, 0, 0, VkImageSubresourceLayers{texture.getAspect(), 0, 0, 1}, VkOffset3D{0, 0, 0}, texture.getSize()};
+    vkCmdCopyImageToBuffer(m_buffer, texture, transfer_state.layout, to, 1, &copy);
+    //move the image to the end state before any following commands use it
     if (end_state != transfer_state){
-        cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, texture.createMemoryBarrier(transfer_state, end_state));
+        cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, texture.createMemoryBarrier(transfer_state, end_state));
+    }
+}
+void CommandBuffer::cmdCopyImage(const Image& from, const Image& to){
+    //one region for each mipmap level, each one covers all array layers
+    vector<VkImageCopy> regions(from.getMipLevels());
+    for (uint32_t i = 0; i < regions.size(); i++){
+        VkExtent3D size = from.getSize();
+        VkImageSubresourceLayers layers{from.getAspect(), i, 0, from.getArrayLayers()};
+        regions[i] = VkImageCopy{layers, VkOffset3D{0, 0, 0}, layers, VkOffset3D{0, 0, 0},
+            VkExtent3D{std::max(size.width >> i, 1u), std::max(size.height >> i, 1u), std::max(size.depth >> i, 1u)}};
     }
+    vkCmdCopyImage(m_buffer, from, ImageState(IMAGE_TRANSFER_SRC).layout, to, ImageState(IMAGE_TRANSFER_DST).layout, regions.size(), regions.data());
 }
 void CommandBuffer::cmdClearColor(const Image& image, ImageState state, VkClearColorValue color){
     //range - all mipmaps, all array layers
@@ -128,9 +163,9 @@ void CommandBuffer::cmdExecuteCommands(const VkCommandBuffer* buffers, uint32_t
     //execute all buffers
     vkCmdExecuteCommands(m_buffer, count, buffers);
 }
-void CommandBuffer::cmdBeginRenderPass(RenderPassSettings& settings, VkRenderPass render_pass, VkFramebuffer framebuffer){
-    //INLINE - renderpass contains no secondary command buffers
-    vkCmdBeginRenderPass(m_buffer, &settings.getBeginInfo(render_pass, framebuffer), VK_SUBPASS_CONTENTS_INLINE);
+void CommandBuffer::cmdBeginRenderPass(RenderPassSettings& settings, VkRenderPass render_pass, VkFramebuffer framebuffer, VkSubpassContents contents){
+    //contents say whether the first subpass is recorded inline, or consists of secondary command buffers only
+    vkCmdBeginRenderPass(m_buffer, &settings.getBeginInfo(render_pass, framebuffer), contents);
 }
 void CommandBuffer::cmdBindPipeline(const Pipeline& pipeline){
     vkCmdBindPipeline(m_buffer, pipeline.getBindPoint(), pipeline);
@@ -153,6 +188,10 @@ void CommandBuffer::cmdBindSets(const Pipeline& pipeline, const vector<VkDescrip
     //record binding given descriptor sets                                                     0 -> no offset                                    (0, nullptr) -> no dynamic offsets 
     vkCmdBindDescriptorSets(m_buffer, pipeline.getBindPoint(), pipeline.getLayout(), 0, descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
 }
+void CommandBuffer::cmdBindSets(const Pipeline& pipeline, const vector<VkDescriptorSet>& descriptor_sets, const vector<uint32_t>& dynamic_offsets){
+    //record binding given descriptor sets, each dynamic descriptor uses one of the offsets
+    vkCmdBindDescriptorSets(m_buffer, pipeline.getBindPoint(), pipeline.getLayout(), 0, descriptor_sets.size(), descriptor_sets.data(), dynamic_offsets.size(), dynamic_offsets.data());
+}
 void CommandBuffer::cmdBindVertexBuffer(VkBuffer buffer, uint32_t binding_offset){
     //offset in buffer
     VkDeviceSize a = 0;
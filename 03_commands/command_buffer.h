@@ -121,6 +121,15 @@ public:
      */
     void cmdBarrier(VkPipelineStageFlags past_stages, VkPipelineStageFlags next_stages, const vector<VkImageMemoryBarrier>& memory_barriers);
 
+    /**
+     * Insert given buffer and image memory barriers into the buffer using one barrier command.
+     * @param past_stages the stage that has to be finished for the memory barrier to execute
+     * @param next_stages the stage at which the barrier will wait for past_stages to finish
+     * @param buffer_memory_barriers the buffer memory barriers to insert
+     * @param image_memory_barriers the image memory barriers to insert
+     */
+    void cmdBarrier(VkPipelineStageFlags past_stages, VkPipelineStageFlags next_stages, const vector<VkBufferMemoryBarrier>& buffer_memory_barriers, const vector<VkImageMemoryBarrier>& image_memory_barriers);
+
     /**
      * Fill image with given color
      * @param image the image to fill
@@ -158,16 +167,48 @@ public:
      * @param to target image
      * @param state state the image is in
      * @param end_state state the image should end in
+     * @param buffer_offset offset of image data in the source buffer
+     */
+    void cmdCopyToTexture(const Buffer& from, Image& to, ImageState state, ImageState end_state, VkDeviceSize buffer_offset = 0);
+
+    /**
+     * Copy tightly packed data from buffer to a region of an image. The image has to be in the IMAGE_TRANSFER_DST state already.
+     * @param from source buffer
+     * @param to target image
+     * @param buffer_offset offset of region data in the source buffer
+     * @param image_offset the first texel of the region
+     * @param extent size of the region in texels
+     * @param mip_level the mipmap level to copy to
+     * @param array_layer the array layer to copy to
+     */
+    void cmdCopyToTextureRegion(const Buffer& from, Image& to, VkDeviceSize buffer_offset, VkOffset3D image_offset, VkExtent3D extent, uint32_t mip_level = 0, uint32_t array_layer = 0);
+
+    /**
+     * Copy the whole image to a buffer, tightly packed
+     * @param from source image
+     * @param state state the image is in, all writes in this state are finished before copying
+     * @param end_state state the image should end in
+     * @param to target buffer
+     * @param buffer_offset offset of image data in the target buffer
      */
-    void cmdCopyToTexture(const Buffer& from, Image& to, ImageState state, ImageState end_state);
+    void cmdCopyFromTexture(Image& from, ImageState state, ImageState end_state, const Buffer& to, VkDeviceSize buffer_offset = 0);
+
+    /**
+     * Copy all mipmap levels and array layers of one image to another image with the same size and format.
+     * The source has to be in the IMAGE_TRANSFER_SRC state and the target in the IMAGE_TRANSFER_DST state already.
+     * @param from source image
+     * @param to target image
+     */
+    void cmdCopyImage(const Image& from, const Image& to);
 
     /**
      * Begin renderpass
      * @param settings begin info and clear colors
      * @param render_pass
      * @param framebuffer
+     * @param contents VK_SUBPASS_CONTENTS_INLINE to record commands directly, or VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS if the first subpass only executes secondary buffers
      */
-    void cmdBeginRenderPass(RenderPassSettings& settings, VkRenderPass render_pass, VkFramebuffer framebuffer);
+    void cmdBeginRenderPass(RenderPassSettings& settings, VkRenderPass render_pass, VkFramebuffer framebuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 
     //Bind given pipeline
     void cmdBindPipeline(const Pipeline& pipeline);
@@ -183,6 +224,14 @@ public:
 
     //Bind given descriptor sets for use with given pipeline 
     void cmdBindSets(const Pipeline& pipeline, const vector<VkDescriptorSet>& descriptor_sets);
+
+    /**
+     * Bind given descriptor sets with dynamic offsets, e.g. offsets of per-frame uniform data returned by UniformRingBuffer
+     * @param pipeline the pipeline the sets will be used with
+     * @param descriptor_sets the sets to bind
+     * @param dynamic_offsets one offset for each dynamic descriptor in the sets, in binding order
+     */
+    void cmdBindSets(const Pipeline& pipeline, const vector<VkDescriptorSet>& descriptor_sets, const vector<uint32_t>& dynamic_offsets);
     
 
     /**
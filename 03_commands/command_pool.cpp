@@ -20,8 +20,7 @@ void CommandPool::reset(bool release_resources){
     DEBUG_CHECK("Reset command pool", result)
 }
 void CommandPool::destroy(){
-    vkDestroyCommandPool(g_device, m_command_pool, nullptr);
-    DEBUG_CHECK("Destroy command pool", 0)
+    g_allocator.get().destroyCommandPool(m_command_pool);
 }
 
 CommandBuffer CommandPool::allocateBuffer(VkCommandBufferLevel level){
@@ -50,4 +49,27 @@ vector<CommandBuffer> CommandPool::allocateBuffers(uint32_t buffer_count, VkComm
 
 
 
-
+TransientCommandPool::TransientCommandPool(uint32_t queue_family_index) :
+    m_pool(CommandPoolInfo{queue_family_index, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT}.create()), m_primary_used(0), m_secondary_used(0)
+{}
+CommandBuffer TransientCommandPool::allocateBuffer(VkCommandBufferLevel level){
+    bool primary = (level == VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    vector<CommandBuffer>& buffers = primary ? m_primary_buffers : m_secondary_buffers;
+    uint32_t& used = primary ? m_primary_used : m_secondary_used;
+    //allocate a new buffer only if all existing ones are already in use
+    if (used == buffers.size()) buffers.push_back(m_pool.allocateBuffer(level));
+    return buffers[used++];
+}
+void TransientCommandPool::reset(){
+    //one reset for the whole pool is cheaper than resetting each buffer, memory is kept for the next use
+    m_pool.reset(false);
+    m_primary_used = 0;
+    m_secondary_used = 0;
+}
+void TransientCommandPool::destroy(){
+    m_pool.destroy();
+    m_primary_buffers.clear();
+    m_secondary_buffers.clear();
+    m_primary_used = 0;
+    m_secondary_used = 0;
+}
@@ -2,8 +2,7 @@
 #define COMMAND_POOL_H
 
 #include "../00_base/vulkan_base.h"
-
-class CommandBuffer;
+#include "command_buffer.h"
 
 
 
@@ -59,4 +58,39 @@ public:
     CommandPool create() const;
 };
 
+
+
+/**
+ * TransientCommandPool
+ *  - Command pool created with VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, for command buffers that are recorded once and thrown away
+ *  - Buffers aren't reset individually - the whole pool is reset at once, then the allocated buffers are handed out again from a free list
+ *  - Like all command pools, it must be used by only one thread at a time
+ */
+class TransientCommandPool{
+    CommandPool m_pool;
+    //all buffers allocated so far, the first m_*_used of them were handed out since the last reset
+    vector<CommandBuffer> m_primary_buffers;
+    vector<CommandBuffer> m_secondary_buffers;
+    uint32_t m_primary_used;
+    uint32_t m_secondary_used;
+public:
+    /**
+     * Create the pool
+     * @param queue_family_index only queues from this family will be able to use command buffers from this pool
+     */
+    TransientCommandPool(uint32_t queue_family_index);
+
+    /**
+     * Get a command buffer that isn't used since the last reset, a new one is allocated only if there is none
+     * @param level VK_COMMAND_BUFFER_LEVEL_PRIMARY or VK_COMMAND_BUFFER_LEVEL_SECONDARY
+     */
+    CommandBuffer allocateBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    //Reset the pool - all buffers handed out since the last reset must have finished executing, they can be handed out again afterwards
+    void reset();
+
+    //Destroy the pool and all its' buffers
+    void destroy();
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "frame_context.h"
+
+#include "../01_device/allocator.h"
+
+
+FrameContext::FrameContext() :
+    command_buffer(VK_NULL_HANDLE), image_available(), in_flight(), frame_index(0)
+{}
+
+
+
+FrameContextRing::FrameContextRing(Queue& queue, uint32_t frames_in_flight) :
+    m_queue(queue), m_frames(frames_in_flight), m_command_allocator(queue.getFamilyIndex(), frames_in_flight), m_frame_index(0), m_image_acquired(false), m_image_index(0)
+{}
+FrameContext& FrameContextRing::beginFrame(){
+    m_frame_index++;
+    m_image_acquired = false;
+    FrameContext& frame = current();
+    //wait for the frame that used this context frames_in_flight frames ago
+    if (!frame.in_flight.waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for frame in flight expired")
+    //objects released during that frame can be destroyed now, this has to happen before the fence is reset
+    g_allocator.get().retireFrames();
+    //all command buffers of the frame finished executing, reset their pool at once
+    m_command_allocator.beginFrame();
+    frame.in_flight.reset();
+    frame.frame_index = m_frame_index;
+    frame.command_buffer = m_command_allocator.allocate();
+    frame.command_buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    return frame;
+}
+FrameContext& FrameContextRing::current(){
+    return m_frames[m_frame_index % m_frames.size()];
+}
+CommandBuffer& FrameContextRing::getCommandBuffer(){
+    return current().command_buffer;
+}
+CommandBuffer FrameContextRing::allocateCommandBuffer(VkCommandBufferLevel level){
+    return m_command_allocator.allocate(level);
+}
+void FrameContextRing::endFrame(VkPipelineStageFlags image_wait_stage){
+    FrameContext& frame = current();
+    frame.command_buffer.endRecord();
+    SubmitSynchronization synchronization;
+    synchronization.setEndFence(frame.in_flight);
+    if (m_image_acquired){
+        synchronization.addStartSemaphore(frame.image_available, image_wait_stage);
+        synchronization.addEndSemaphore(m_render_finished[m_image_index]);
+    }
+    m_queue.submit(frame.command_buffer, synchronization);
+    //everything released during the frame is destroyed once the fence signals, its' command buffers are reused after that too
+    g_allocator.get().endFrame(frame.in_flight);
+    m_command_allocator.endFrame(frame.in_flight);
+}
+void FrameContextRing::waitAll(){
+    for (FrameContext& frame : m_frames){
+        if (!frame.in_flight.waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for frame in flight expired")
+    }
+}
+uint32_t FrameContextRing::getFramesInFlight() const{
+    return m_frames.size();
+}
+uint64_t FrameContextRing::getFrameIndex() const{
+    return m_frame_index;
+}
+void FrameContextRing::setAcquiredImage(const SwapchainImage& image){
+    //if no image was acquired, the semaphore won't be signaled and must not be waited for
+    m_image_acquired = (image.get() != VK_NULL_HANDLE);
+    if (!m_image_acquired) return;
+    m_image_index = image.getIndex();
+    //the swapchain may have more images after recreation
+    while (m_render_finished.size() <= m_image_index){
+        m_render_finished.push_back(Semaphore());
+    }
+}
+void FrameContextRing::destroy(){
+    waitAll();
+    m_command_allocator.destroy();
+}
@@ -0,0 +1,126 @@
+#ifndef FRAME_CONTEXT_H
+#define FRAME_CONTEXT_H
+
+/**
+ * frame_context.h
+ *  - Holds classes that own per-frame synchronization objects and command buffers, so that multiple frames can be in flight at once
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "../01_device/device.h"
+#include "../02_swapchain/swapchain.h"
+#include "command_buffer.h"
+#include "command_pool.h"
+#include "synchronization.h"
+#include "transient_command_allocator.h"
+
+
+/**
+ * FrameContext
+ *  - All objects used by one frame in flight
+ */
+class FrameContext{
+public:
+    //primary command buffer of the frame, allocated from the transient pool of the frame every time the frame context is reused
+    CommandBuffer command_buffer;
+    //signaled when the acquired swapchain image can be written to
+    Semaphore image_available;
+    //signaled when the GPU finishes all work of the frame
+    SignaledFence in_flight;
+    //index of the frame that last used this context
+    uint64_t frame_index;
+
+    //create synchronization objects for a frame
+    FrameContext();
+};
+
+
+/**
+ * FrameContextRing
+ *  - A ring of FrameContexts, one for each frame in flight. The CPU records frame N+1 while the GPU still executes frame N,
+ *    the CPU waits only when it gets more than frames_in_flight frames ahead
+ *  - Ends the frame in the global allocator as well, objects released during a frame are destroyed once the frame finishes
+ *  - Command buffers come from a TransientCommandAllocator, the pool of each frame is reset at once when the frame context is reused
+ *  - Usage each frame: beginFrame(), acquireImage(), record into getCommandBuffer(), endFrame(), present()
+ */
+class FrameContextRing{
+    Queue& m_queue;
+    vector<FrameContext> m_frames;
+    //one transient command pool per frame in flight
+    TransientCommandAllocator m_command_allocator;
+    //number of frames started so far
+    uint64_t m_frame_index;
+    //whether a swapchain image was acquired during current frame, the submit then waits for the image and signals render finished semaphore of the image
+    bool m_image_acquired;
+    //index of the image acquired during current frame
+    uint32_t m_image_index;
+    //for each swapchain image, signaled when rendering into it finishes, presentation waits for it. Kept per image, not per frame in flight,
+    //the semaphore is free again only once the presentation engine is done with the image, which is known when the image is acquired again
+    vector<Semaphore> m_render_finished;
+public:
+    /**
+     * Create the ring of frame contexts
+     * @param queue the queue frames are submitted and presented on
+     * @param frames_in_flight how many frames can be in flight at once, usually 2 or 3
+     */
+    FrameContextRing(Queue& queue, uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT);
+
+    /**
+     * Start a new frame. Waits until the GPU finishes the frame that used the same context, destroys objects released during it,
+     * resets the command pool and starts recording the command buffer of the frame.
+     */
+    FrameContext& beginFrame();
+
+    /**
+     * Acquire a swapchain image for the current frame, the submit in endFrame() waits until it is available. Returns an invalid image if none could be acquired
+     * @param swapchain Swapchain, or a class with the same semaphore acquire and present functions, e.g. OffscreenSwapchain
+     */
+    template<typename SwapchainType>
+    SwapchainImage acquireImage(SwapchainType& swapchain){
+        SwapchainImage image = swapchain.acquireImage(current().image_available);
+        setAcquiredImage(image);
+        return image;
+    }
+
+    //Get the context of the current frame
+    FrameContext& current();
+
+    //Get the command buffer of the current frame
+    CommandBuffer& getCommandBuffer();
+
+    //Get an additional command buffer valid during the current frame, e.g. a secondary buffer or a buffer for another submit to the same queue
+    CommandBuffer allocateCommandBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    /**
+     * End recording and submit the command buffer of the current frame.
+     * @param image_wait_stage stage at which the acquired image is first written to, writes before this stage may run before the image is available
+     */
+    void endFrame(VkPipelineStageFlags image_wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+    //Present the image acquired during the current frame once rendering finishes, the swapchain is of the same type as in acquireImage()
+    template<typename SwapchainType>
+    void present(SwapchainType& swapchain, const SwapchainImage& image){
+        if (!m_image_acquired){
+            PRINT_ERROR("Presenting without an acquired image")
+            return;
+        }
+        swapchain.presentImage(image, m_queue, m_render_finished[m_image_index]);
+    }
+
+    //Wait until all frames in flight finish
+    void waitAll();
+
+    uint32_t getFramesInFlight() const;
+    //Get the index of the current frame
+    uint64_t getFrameIndex() const;
+
+    //Wait for all frames, then destroy all command pools
+    void destroy();
+private:
+    //Remember the image acquired during current frame, create a render finished semaphore for it if there isn't one yet
+    void setAcquiredImage(const SwapchainImage& image);
+};
+
+
+#endif
@@ -0,0 +1,129 @@
+#include "parallel_recorder.h"
+
+
+CommandPoolCache::CommandPoolCache(uint32_t queue_family_index) : m_queue_family_index(queue_family_index)
+{}
+TransientCommandPool& CommandPoolCache::get(){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unique_ptr<TransientCommandPool>& pool = m_pools[std::this_thread::get_id()];
+    if (!pool) pool = unique_ptr<TransientCommandPool>(new TransientCommandPool(m_queue_family_index));
+    return *pool;
+}
+void CommandPoolCache::reset(){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& p : m_pools){
+        p.second->reset();
+    }
+}
+void CommandPoolCache::destroy(){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& p : m_pools){
+        p.second->destroy();
+    }
+    m_pools.clear();
+}
+
+
+
+ParallelRecorder::ParallelRecorder(uint32_t queue_family_index, uint32_t frames_in_flight, uint32_t thread_count) :
+    m_frame_slot(0), m_jobs(nullptr), m_inheritance(nullptr), m_usage(0), m_next_job(0), m_finished_jobs(0), m_job_count(0), m_batch(0), m_active_workers(0), m_stop(false)
+{
+    for (uint32_t i = 0; i < frames_in_flight; i++){
+        m_frame_pools.push_back(unique_ptr<CommandPoolCache>(new CommandPoolCache(queue_family_index)));
+    }
+    //the recording thread works too, so one core is left for it
+    if (thread_count == 0){
+        uint32_t cores = std::thread::hardware_concurrency();
+        thread_count = cores > 1 ? cores - 1 : 1;
+    }
+    for (uint32_t i = 0; i < thread_count; i++){
+        m_workers.emplace_back(&ParallelRecorder::workerLoop, this);
+    }
+}
+ParallelRecorder::~ParallelRecorder(){
+    //destroying a joinable thread terminates the program
+    stopWorkers();
+}
+void ParallelRecorder::beginFrame(){
+    m_frame_slot = (m_frame_slot + 1) % m_frame_pools.size();
+    m_frame_pools[m_frame_slot]->reset();
+}
+void ParallelRecorder::record(CommandBuffer& primary, const CommandBufferInheritanceInfo& inheritance, const vector<RecordJob>& jobs){
+    if (jobs.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs = &jobs;
+        m_inheritance = &static_cast<const VkCommandBufferInheritanceInfo&>(inheritance);
+        //buffers used inside a render pass must say so when recording starts
+        m_usage = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (m_inheritance->renderPass != VK_NULL_HANDLE) m_usage |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        m_recorded.assign(jobs.size(), VK_NULL_HANDLE);
+        m_job_count = jobs.size();
+        m_next_job = 0;
+        m_finished_jobs = 0;
+        m_batch++;
+    }
+    m_work_available.notify_all();
+    //record on this thread as well instead of just waiting
+    recordJobs();
+    {
+        //workers may still hold references to the jobs, wait until all of them stop
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_work_done.wait(lock, [this]{return m_finished_jobs == m_job_count && m_active_workers == 0;});
+        m_jobs = nullptr;
+        m_inheritance = nullptr;
+        m_job_count = 0;
+    }
+    primary.cmdExecuteCommands(m_recorded.data(), m_recorded.size());
+}
+uint32_t ParallelRecorder::getThreadCount() const{
+    return m_workers.size();
+}
+void ParallelRecorder::destroy(){
+    stopWorkers();
+    for (unique_ptr<CommandPoolCache>& pools : m_frame_pools){
+        pools->destroy();
+    }
+}
+void ParallelRecorder::stopWorkers(){
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_work_available.notify_all();
+    for (std::thread& t : m_workers){
+        t.join();
+    }
+    m_workers.clear();
+}
+void ParallelRecorder::workerLoop(){
+    uint64_t last_batch = 0;
+    while (true){
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_available.wait(lock, [&]{return m_stop || (m_batch != last_batch && m_jobs != nullptr);});
+            if (m_stop) return;
+            last_batch = m_batch;
+            m_active_workers++;
+        }
+        recordJobs();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active_workers--;
+        }
+        m_work_done.notify_all();
+    }
+}
+void ParallelRecorder::recordJobs(){
+    TransientCommandPool& pool = m_frame_pools[m_frame_slot]->get();
+    while (true){
+        uint32_t i = m_next_job++;
+        if (i >= m_job_count) return;
+        CommandBuffer buffer = pool.allocateBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        buffer.startRecordSecondary(*m_inheritance, m_usage);
+        (*m_jobs)[i](buffer);
+        buffer.endRecord();
+        m_recorded[i] = buffer.get();
+        m_finished_jobs++;
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef PARALLEL_RECORDER_H
+#define PARALLEL_RECORDER_H
+
+/**
+ * parallel_recorder.h
+ *  - Holds classes for recording command buffers from multiple threads - a per-thread command pool cache and a recorder
+ *    that records secondary command buffers on worker threads
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "command_buffer.h"
+#include "command_pool.h"
+#include "transient_command_allocator.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using std::unique_ptr;
+
+
+/**
+ * CommandPoolCache
+ *  - Holds one TransientCommandPool for each thread that asked for one, pools are created on first use. Command pools can't be used from multiple threads at once
+ *  - All buffers allocated from the pools have to finish executing before reset() is called
+ */
+class CommandPoolCache{
+    uint32_t m_queue_family_index;
+    //guards the map only, each pool is used just by its' own thread
+    std::mutex m_mutex;
+    //pointers, so that references to pools stay valid when new threads are added
+    std::map<std::thread::id, unique_ptr<TransientCommandPool>> m_pools;
+public:
+    //create an empty cache, pools will be created for given queue family
+    CommandPoolCache(uint32_t queue_family_index);
+
+    //Get the pool of the calling thread, create it if it doesn't exist yet
+    TransientCommandPool& get();
+
+    //Reset pools of all threads
+    void reset();
+
+    //Destroy pools of all threads
+    void destroy();
+};
+
+
+//one job of the parallel recorder, records commands into the given secondary command buffer
+using RecordJob = std::function<void(CommandBuffer&)>;
+
+
+/**
+ * ParallelRecorder
+ *  - Records secondary command buffers on worker threads, then executes them from a primary command buffer in job order
+ *  - Holds a CommandPoolCache for each frame in flight, beginFrame() moves to the next one and resets it
+ *  - Jobs must only record commands - they run concurrently and the order in which they run is not defined
+ *  - Recording inside a render pass requires it to be started with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS,
+ *    and inheritance info with the same render pass and subpass
+ */
+class ParallelRecorder{
+    vector<unique_ptr<CommandPoolCache>> m_frame_pools;
+    //index of the pool cache used by current frame
+    uint32_t m_frame_slot;
+    vector<std::thread> m_workers;
+
+    //guards the batch information below, workers wait on m_work_available and the recording thread on m_work_done
+    std::mutex m_mutex;
+    std::condition_variable m_work_available;
+    std::condition_variable m_work_done;
+    //jobs being recorded and where to put the recorded buffers
+    const vector<RecordJob>* m_jobs;
+    const VkCommandBufferInheritanceInfo* m_inheritance;
+    VkCommandBufferUsageFlags m_usage;
+    vector<VkCommandBuffer> m_recorded;
+    //index of the next job to take, and the number of finished jobs
+    std::atomic<uint32_t> m_next_job;
+    std::atomic<uint32_t> m_finished_jobs;
+    uint32_t m_job_count;
+    //incremented for every batch, so that workers know there is new work
+    uint64_t m_batch;
+    //workers currently recording, the batch ends when all jobs are finished and all workers stopped
+    uint32_t m_active_workers;
+    bool m_stop;
+public:
+    /**
+     * Create the recorder and start worker threads
+     * @param queue_family_index family of the queue the primary command buffers are submitted to
+     * @param frames_in_flight how many frames can be in flight at once, secondary buffers of a frame are reused only after frames_in_flight frames
+     * @param thread_count number of worker threads, the thread calling record() also records. 0 uses one thread less than the number of cores
+     */
+    ParallelRecorder(uint32_t queue_family_index, uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT, uint32_t thread_count = 0);
+
+    //Stop and join worker threads that are still running, command pools are destroyed only by destroy()
+    ~ParallelRecorder();
+
+    /**
+     * Move to the pools of the next frame and reset them. The frame that used them last must have finished on the GPU already -
+     * calling this right after FrameContextRing::beginFrame() with the same number of frames in flight guarantees that.
+     */
+    void beginFrame();
+
+    /**
+     * Record each job into its' own secondary command buffer in parallel, then execute them in order from the primary buffer.
+     * Returns once all jobs are recorded.
+     * @param primary the primary command buffer, recording
+     * @param inheritance inheritance info of the secondary buffers - the render pass, subpass and framebuffer they are executed in, if any
+     * @param jobs jobs to record
+     */
+    void record(CommandBuffer& primary, const CommandBufferInheritanceInfo& inheritance, const vector<RecordJob>& jobs);
+
+    //Get the number of worker threads
+    uint32_t getThreadCount() const;
+
+    //Stop all worker threads and destroy all command pools. All recorded buffers must have finished executing
+    void destroy();
+private:
+    //Tell all worker threads to stop and wait until they finish, does nothing if they were stopped already
+    void stopWorkers();
+    //Wait for batches of jobs and record them, runs on worker threads
+    void workerLoop();
+    //Take jobs from the current batch and record them until there are none left
+    void recordJobs();
+};
+
+
+#endif
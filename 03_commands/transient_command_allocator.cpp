@@ -0,0 +1,36 @@
+#include "transient_command_allocator.h"
+
+
+TransientCommandAllocator::TransientCommandAllocator(uint32_t queue_family_index, uint32_t frames_in_flight) :
+    m_fences(frames_in_flight, VK_NULL_HANDLE), m_current(0)
+{
+    m_pools.reserve(frames_in_flight);
+    for (uint32_t i = 0; i < frames_in_flight; i++){
+        m_pools.push_back(TransientCommandPool(queue_family_index));
+    }
+}
+void TransientCommandAllocator::beginFrame(){
+    m_current = (m_current + 1) % m_pools.size();
+    //buffers of the pool can be reused only once the frame that used them finishes
+    if (m_fences[m_current] != VK_NULL_HANDLE){
+        if (!Fence(m_fences[m_current]).waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for command buffers of an older frame expired")
+        m_fences[m_current] = VK_NULL_HANDLE;
+    }
+    m_pools[m_current].reset();
+}
+CommandBuffer TransientCommandAllocator::allocate(VkCommandBufferLevel level){
+    return m_pools[m_current].allocateBuffer(level);
+}
+void TransientCommandAllocator::endFrame(VkFence fence){
+    m_fences[m_current] = fence;
+}
+uint32_t TransientCommandAllocator::getFramesInFlight() const{
+    return m_pools.size();
+}
+void TransientCommandAllocator::destroy(){
+    for (uint32_t i = 0; i < m_pools.size(); i++){
+        if (m_fences[i] != VK_NULL_HANDLE && !Fence(m_fences[i]).waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for command buffers of an older frame expired")
+        m_pools[i].destroy();
+    }
+    m_fences.assign(m_fences.size(), VK_NULL_HANDLE);
+}
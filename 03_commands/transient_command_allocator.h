@@ -0,0 +1,66 @@
+#ifndef TRANSIENT_COMMAND_ALLOCATOR_H
+#define TRANSIENT_COMMAND_ALLOCATOR_H
+
+/**
+ * transient_command_allocator.h
+ *  - TransientCommandAllocator class, hands out command buffers that are used during one frame only
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "command_buffer.h"
+#include "command_pool.h"
+#include "synchronization.h"
+
+
+//number of frames in flight used by default. More frames let the CPU get further ahead of the GPU, at the cost of latency and memory
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+
+/**
+ * TransientCommandAllocator
+ *  - Holds one TransientCommandPool for each frame in flight. Command buffers are allocated from the pool of the current frame,
+ *    and the pool is reset as a whole once the fence of the frame that used it last signals
+ *  - Buffers don't need to be reset individually and are reused from frame to frame, so no allocations happen once the pools are warmed up
+ *  - Usage each frame: beginFrame(), allocate() as many buffers as needed, submit them, endFrame() with the fence of the last submit
+ */
+class TransientCommandAllocator{
+    vector<TransientCommandPool> m_pools;
+    //fence of the frame that last used each pool, VK_NULL_HANDLE if the pool wasn't used yet
+    vector<VkFence> m_fences;
+    //index of the pool of the current frame
+    uint32_t m_current;
+public:
+    /**
+     * Create pools for all frames in flight
+     * @param queue_family_index family of the queue the buffers will be submitted to
+     * @param frames_in_flight how many frames can be in flight at once
+     */
+    TransientCommandAllocator(uint32_t queue_family_index, uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT);
+
+    /**
+     * Move to the pool of the next frame, wait for the fence of the frame that used it last and reset it.
+     * The fence must not be reset by its' owner before this is called.
+     */
+    void beginFrame();
+
+    /**
+     * Get a command buffer for the current frame, it is valid until the pool is reset frames_in_flight frames later
+     * @param level VK_COMMAND_BUFFER_LEVEL_PRIMARY or VK_COMMAND_BUFFER_LEVEL_SECONDARY
+     */
+    CommandBuffer allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    /**
+     * End the current frame
+     * @param fence signaled when all buffers allocated during the frame finish executing
+     */
+    void endFrame(VkFence fence);
+
+    uint32_t getFramesInFlight() const;
+
+    //Wait for all frames, then destroy all pools
+    void destroy();
+};
+
+
+#endif
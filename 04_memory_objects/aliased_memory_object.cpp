@@ -0,0 +1,104 @@
+#include "aliased_memory_object.h"
+
+#include "../01_device/allocator.h"
+#include <algorithm>
+
+
+AliasedResource::AliasedResource(VkImage image_, VkBuffer buffer_, const VkMemoryRequirements& requirements_, uint32_t first_use_, uint32_t last_use_) :
+    image(image_), buffer(buffer_), requirements(requirements_), first_use(first_use_), last_use(last_use_), offset(0)
+{}
+bool AliasedResource::aliveWith(const AliasedResource& other) const{
+    return first_use <= other.last_use && other.first_use <= last_use;
+}
+
+
+
+AliasedMemoryObject::AliasedMemoryObject() : m_resources(), m_memory()
+{}
+AliasedMemoryObject& AliasedMemoryObject::addImage(const Image& image, uint32_t first_use, uint32_t last_use){
+    m_resources.push_back(AliasedResource(image, VK_NULL_HANDLE, image.getMemoryRequirements(), first_use, last_use));
+    return *this;
+}
+AliasedMemoryObject& AliasedMemoryObject::addBuffer(const Buffer& buffer, uint32_t first_use, uint32_t last_use){
+    m_resources.push_back(AliasedResource(VK_NULL_HANDLE, buffer, buffer.getMemoryRequirements(), first_use, last_use));
+    return *this;
+}
+void AliasedMemoryObject::allocate(const MemoryTypeRequest& request){
+    if (m_resources.empty()){
+        PRINT_WARN("Allocating aliased memory without any resources")
+        return;
+    }
+    //all usable memory types and the alignment of the whole allocation
+    uint32_t memory_type_bits = 0xFFFFFFFF;
+    VkDeviceSize alignment = 1;
+    bool has_images = false, has_buffers = false;
+    for (const AliasedResource& resource : m_resources){
+        memory_type_bits &= resource.requirements.memoryTypeBits;
+        alignment = std::max(alignment, resource.requirements.alignment);
+        if (resource.image != VK_NULL_HANDLE) has_images = true;
+        else has_buffers = true;
+    }
+    //if both images and buffers are present, linear and optimal resources may end up next to each other, keep each resource on its' own granularity pages
+    VkDeviceSize granularity = (has_images && has_buffers) ? g_allocator.get().getLimits().bufferImageGranularity : 1;
+    alignment = std::max(alignment, granularity);
+
+    //place larger resources first, they are the hardest to fit into gaps
+    vector<uint32_t> order(m_resources.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b){
+        return m_resources[a].requirements.size > m_resources[b].requirements.size;
+    });
+    vector<uint32_t> placed;
+    VkDeviceSize size = 0;
+    for (uint32_t index : order){
+        AliasedResource& resource = m_resources[index];
+        VkDeviceSize resource_alignment = std::max(resource.requirements.alignment, granularity);
+        //start at the beginning, move after every resource alive at the same time that overlaps the current range, until no such resource is left
+        VkDeviceSize offset = 0;
+        bool moved = true;
+        while (moved){
+            moved = false;
+            for (uint32_t other_index : placed){
+                const AliasedResource& other = m_resources[other_index];
+                VkDeviceSize other_end = other.offset + other.requirements.size;
+                if (resource.aliveWith(other) && offset < other_end && other.offset < offset + resource.requirements.size){
+                    offset = roundUpToMemoryBlock(other_end, resource_alignment);
+                    moved = true;
+                }
+            }
+        }
+        resource.offset = offset;
+        placed.push_back(index);
+        size = std::max(size, offset + resource.requirements.size);
+    }
+    size = roundUpToMemoryBlock(size, alignment);
+
+    //allocate the memory, then bind all resources to their offsets
+    m_memory = g_allocator.get().allocateMemory(size, memory_type_bits, request, alignment, has_images ? MEMORY_RESOURCE_OPTIMAL : MEMORY_RESOURCE_LINEAR);
+    for (const AliasedResource& resource : m_resources){
+        VkResult result;
+        if (resource.image != VK_NULL_HANDLE){
+            result = vkBindImageMemory(g_device, resource.image, m_memory.memory, m_memory.offset + resource.offset);
+        }else{
+            result = vkBindBufferMemory(g_device, resource.buffer, m_memory.memory, m_memory.offset + resource.offset);
+        }
+        DEBUG_CHECK("Aliased memory binding", result)
+    }
+}
+VkDeviceSize AliasedMemoryObject::getSize() const{
+    return m_memory.size;
+}
+VkDeviceSize AliasedMemoryObject::getUnaliasedSize() const{
+    VkDeviceSize size = 0;
+    for (const AliasedResource& resource : m_resources){
+        size += resource.requirements.size;
+    }
+    return size;
+}
+VkDeviceSize AliasedMemoryObject::getOffset(uint32_t resource_index) const{
+    return m_resources[resource_index].offset;
+}
+void AliasedMemoryObject::free(){
+    g_allocator.get().free(m_memory);
+    m_memory = MemoryAllocation();
+}
@@ -0,0 +1,91 @@
+#ifndef ALIASED_MEMORY_OBJECT_H
+#define ALIASED_MEMORY_OBJECT_H
+
+/**
+ * aliased_memory_object.h
+ *  - Holds a memory object that lets transient images and buffers with non-overlapping lifetimes share memory
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "../01_device/memory_block.h"
+#include "buffer.h"
+#include "image.h"
+
+
+/**
+ * AliasedResource
+ *  - One image or buffer placed into an AliasedMemoryObject, together with the range of passes it is used in
+ */
+class AliasedResource{
+public:
+    //exactly one of image and buffer is valid
+    VkImage image;
+    VkBuffer buffer;
+    VkMemoryRequirements requirements;
+    //index of the first and last pass the resource is used in, both inclusive
+    uint32_t first_use;
+    uint32_t last_use;
+    //offset from the start of the shared allocation, set by AliasedMemoryObject::allocate()
+    VkDeviceSize offset;
+
+    AliasedResource(VkImage image_, VkBuffer buffer_, const VkMemoryRequirements& requirements_, uint32_t first_use_, uint32_t last_use_);
+
+    //return true if both resources are used in at least one common pass
+    bool aliveWith(const AliasedResource& other) const;
+};
+
+
+/**
+ * AliasedMemoryObject
+ *  - Allocates one range of memory for transient images and buffers. Resources that are never used in the same pass may get the same memory.
+ *  - Passes are any increasing indices, e.g. the order of render passes during a frame. E.g. a post-processing chain where every pass reads
+ *    the result of the previous one needs memory for just two images, no matter how many passes there are.
+ *  - Contents of aliased memory are undefined whenever a different resource starts using it - images have to be transitioned from VK_IMAGE_LAYOUT_UNDEFINED
+ *    on first use in a pass, and a barrier must separate the last use of a resource from the first use of any resource sharing its' memory
+ */
+class AliasedMemoryObject{
+    vector<AliasedResource> m_resources;
+    MemoryAllocation m_memory;
+public:
+    //create an empty memory object, resources are added using addImage and addBuffer
+    AliasedMemoryObject();
+
+    /**
+     * Add an image that will be placed into the memory
+     * @param image the image, it must not have any memory bound yet
+     * @param first_use index of the first pass the image is used in
+     * @param last_use index of the last pass the image is used in
+     */
+    AliasedMemoryObject& addImage(const Image& image, uint32_t first_use, uint32_t last_use);
+
+    /**
+     * Add a buffer that will be placed into the memory
+     * @param buffer the buffer, it must not have any memory bound yet
+     * @param first_use index of the first pass the buffer is used in
+     * @param last_use index of the last pass the buffer is used in
+     */
+    AliasedMemoryObject& addBuffer(const Buffer& buffer, uint32_t first_use, uint32_t last_use);
+
+    /**
+     * Place all added resources, allocate memory for them and bind it. Larger resources are placed first, each one at the lowest offset that isn't used by
+     * any resource alive at the same time.
+     * @param request memory type request, device local memory only accessed by the GPU by default
+     */
+    void allocate(const MemoryTypeRequest& request = MemoryTypeRequest(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, MEMORY_USAGE_GPU_ONLY));
+
+    //Return the size of the allocation in bytes
+    VkDeviceSize getSize() const;
+
+    //Return how many bytes all resources would need without aliasing
+    VkDeviceSize getUnaliasedSize() const;
+
+    //Get offset of a resource from the start of the allocation, resources are indexed in the order they were added in
+    VkDeviceSize getOffset(uint32_t resource_index) const;
+
+    //Return the memory to the allocator. No resource placed in it may be used by the device anymore
+    void free();
+};
+
+
+#endif
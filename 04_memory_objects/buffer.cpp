@@ -1,11 +1,17 @@
 #include "buffer.h"
 
 #include "../01_device/allocator.h"
+#include <algorithm>
 
-Buffer::Buffer() : m_buffer(VK_NULL_HANDLE), m_size(0)
-{}
-Buffer::Buffer(VkBuffer buffer, const VkBufferCreateInfo& info) : m_buffer(buffer), m_size(info.size)
-{}
+Buffer::Buffer() : m_buffer(VK_NULL_HANDLE), m_size(0), m_create_info{}
+{
+    m_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+}
+Buffer::Buffer(VkBuffer buffer, const VkBufferCreateInfo& info) : m_buffer(buffer), m_size(info.size), m_create_info(info)
+{
+    m_create_info.pNext = nullptr;
+    m_create_info.pQueueFamilyIndices = nullptr;
+}
 VkBufferMemoryBarrier Buffer::createMemoryBarrier(VkAccessFlags current_access, VkAccessFlags new_access, uint32_t current_queue_family, uint32_t new_queue_family)
 {
     //fill the memory barrier structure
@@ -36,6 +42,12 @@ VkMemoryRequirements Buffer::getMemoryRequirements() const{
 VkDeviceSize Buffer::getSize() const{
     return m_size;
 }
+const VkBufferCreateInfo& Buffer::getCreateInfo() const{
+    return m_create_info;
+}
+void Buffer::rebind(VkBuffer buffer){
+    m_buffer = buffer;
+}
 Buffer::operator const VkBuffer&() const {
     return m_buffer;
 }
@@ -50,12 +62,13 @@ const MixedBufferLayout& UniformBuffer::getVariables() const{
 
 
 
-BufferMemoryObject::BufferMemoryObject(const vector<Buffer>& buffers, VkMemoryPropertyFlags memory_properties) :
-    m_buffer_offsets(buffers.size() + 1)
+BufferMemoryObject::BufferMemoryObject(const vector<Buffer>& buffers, const MemoryTypeRequest& request) :
+    m_buffer_offsets(buffers.size() + 1), m_alignment(1)
 {
     //buffer offsets must be multiples of this value
     VkDeviceSize buffer_offset_multiplier = g_allocator.get().getLimits().nonCoherentAtomSize;
-
+    //alignment of the whole allocation, the largest one required by any of the buffers
+    VkDeviceSize alignment = buffer_offset_multiplier;
     
     m_buffer_offsets[0] = 0;
     //all memory types that can be used
@@ -67,41 +80,128 @@ BufferMemoryObject::BufferMemoryObject(const vector<Buffer>& buffers, VkMemoryPr
         memory_requirements = buffers[i].getMemoryRequirements();
         //eliminate all memory types unusable for current buffer
         memory_type_bits &= memory_requirements.memoryTypeBits;
+        //current buffer offset has to respect the buffer alignment as well
+        m_buffer_offsets[i] = roundUpToMemoryBlock<VkDeviceSize>(m_buffer_offsets[i], memory_requirements.alignment);
+        alignment = std::max(alignment, memory_requirements.alignment);
         //Compute offset of next buffer - add padding to make the buffer offset align with memory blocks
         m_buffer_offsets[i + 1] = m_buffer_offsets[i] + roundUpToMemoryBlock(memory_requirements.size, buffer_offset_multiplier);
     }
     //allocate memory with given properties and correct type - last buffer offset is equal to size of all previous buffers, is passed as size
-    m_memory = g_allocator.get().allocateMemory(m_buffer_offsets.back(), memory_type_bits, memory_properties);
-    //bind allocated memory to each individual buffer
+    m_memory = g_allocator.get().allocateMemory(m_buffer_offsets.back(), memory_type_bits, request, alignment, MEMORY_RESOURCE_LINEAR);
+    m_alignment = alignment;
+    //bind allocated memory to each individual buffer, buffer offsets are relative to the allocation start
     for (uint32_t i = 0; i < buffers.size(); i++){
-        VkResult result = vkBindBufferMemory(g_device, buffers[i], m_memory, m_buffer_offsets[i]);
+        VkResult result = vkBindBufferMemory(g_device, buffers[i], m_memory.memory, m_memory.offset + m_buffer_offsets[i]);
         DEBUG_CHECK("Buffer memory binding", result);
     }  
 }
+void BufferMemoryObject::free(){
+    g_allocator.get().free(m_memory);
+    m_memory = MemoryAllocation();
+}
+VkMemoryPropertyFlags BufferMemoryObject::getPropertyFlags() const{
+    return g_allocator.get().getMemoryTypeProperties(m_memory.memory_type);
+}
+const MemoryAllocation& BufferMemoryObject::getMemory() const{
+    return m_memory;
+}
+VkDeviceSize BufferMemoryObject::getAlignment() const{
+    return m_alignment;
+}
+VkDeviceSize BufferMemoryObject::getBufferOffset(int buffer_index) const{
+    return m_buffer_offsets[buffer_index];
+}
+void BufferMemoryObject::rebind(const MemoryAllocation& memory){
+    g_allocator.get().releaseMemory(m_memory);
+    m_memory = memory;
+}
 
 
 
 
-SharedBufferMemoryObject::SharedBufferMemoryObject(const vector<Buffer>& buffers, VkMemoryPropertyFlags memory_properties)
-    : BufferMemoryObject(buffers, memory_properties)
+SharedBufferMemoryObject::SharedBufferMemoryObject(const vector<Buffer>& buffers, const MemoryTypeRequest& request)
+    : BufferMemoryObject(buffers, request)
 {
     //get a pointer to shared memory
-    m_data = g_allocator.get().mapMemory(m_memory, 0, m_buffer_offsets.back());
+    m_data = g_allocator.get().mapMemory(m_memory);
+    //check which type was actually picked
+    m_coherent = getPropertyFlags() & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 }
 void SharedBufferMemoryObject::copyToBuffer(int buffer_index, const void* data, VkDeviceSize size, VkDeviceSize offset){
     //copy given data to shared memory
-    memcpy(reinterpret_cast<uint8_t*>(m_data) + m_buffer_offsets[buffer_index], data, size);
+    memcpy(getData(buffer_index) + offset, data, size);
     //flush the memory range - make sure the data is usable by the GPU for all following commands
-    //both start and end values must be multiplies of memory block size, take nearest before and after copied range as boundary points
-    VkDeviceSize memory_block_size = g_allocator.get().getLimits().nonCoherentAtomSize;
-    VkMappedMemoryRange mapped_memory{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, m_memory,
-        roundDownToMemoryBlock(m_buffer_offsets[buffer_index] + offset, memory_block_size), roundUpToMemoryBlock(size, memory_block_size)};
+    flush(buffer_index, offset, size);
+}
+void SharedBufferMemoryObject::write(int buffer_index, const void* data, VkDeviceSize size, VkDeviceSize offset){
+    memcpy(getData(buffer_index) + offset, data, size);
+    if (m_coherent) return;
+    //save the range for flushing later, merge it with the last one if they overlap or touch
+    VkMappedMemoryRange range = getMappedRange(buffer_index, offset, size);
+    if (!m_pending_flushes.empty()){
+        VkMappedMemoryRange& last = m_pending_flushes.back();
+        if (range.offset <= last.offset + last.size && last.offset <= range.offset + range.size){
+            VkDeviceSize end = std::max(last.offset + last.size, range.offset + range.size);
+            last.offset = std::min(last.offset, range.offset);
+            last.size = end - last.offset;
+            return;
+        }
+    }
+    m_pending_flushes.push_back(range);
+}
+void SharedBufferMemoryObject::flushPending(){
+    if (m_pending_flushes.empty()) return;
+    VkResult result = vkFlushMappedMemoryRanges(g_device, m_pending_flushes.size(), m_pending_flushes.data());
+    DEBUG_CHECK("Memory flush", result)
+    m_pending_flushes.clear();
+}
+void SharedBufferMemoryObject::copyFromBuffer(int buffer_index, void* data, VkDeviceSize size, VkDeviceSize offset){
+    //make sure GPU writes are visible, then copy the data
+    invalidate(buffer_index, offset, size);
+    memcpy(data, getData(buffer_index) + offset, size);
+}
+uint8_t* SharedBufferMemoryObject::getData(int buffer_index){
+    return reinterpret_cast<uint8_t*>(m_data) + m_buffer_offsets[buffer_index];
+}
+void SharedBufferMemoryObject::flush(int buffer_index, VkDeviceSize offset, VkDeviceSize size){
+    //coherent memory is visible to the GPU without flushing
+    if (m_coherent) return;
+    VkMappedMemoryRange mapped_memory = getMappedRange(buffer_index, offset, size);
     VkResult result = vkFlushMappedMemoryRanges(g_device, 1, &mapped_memory);
     DEBUG_CHECK("Memory flush", result)
 }
+void SharedBufferMemoryObject::invalidate(int buffer_index, VkDeviceSize offset, VkDeviceSize size){
+    if (m_coherent) return;
+    VkMappedMemoryRange mapped_memory = getMappedRange(buffer_index, offset, size);
+    VkResult result = vkInvalidateMappedMemoryRanges(g_device, 1, &mapped_memory);
+    DEBUG_CHECK("Memory invalidate", result)
+}
+void SharedBufferMemoryObject::invalidateAll(){
+    if (m_coherent) return;
+    //the memory of all buffers is continuous, one range covers all of them
+    VkMappedMemoryRange mapped_memory = getMappedRange(0, 0, m_buffer_offsets.back());
+    VkResult result = vkInvalidateMappedMemoryRanges(g_device, 1, &mapped_memory);
+    DEBUG_CHECK("Memory invalidate", result)
+}
+bool SharedBufferMemoryObject::isCoherent() const{
+    return m_coherent;
+}
+VkMappedMemoryRange SharedBufferMemoryObject::getMappedRange(int buffer_index, VkDeviceSize offset, VkDeviceSize size) const{
+    //both start and end values must be multiplies of memory block size, take nearest before and after the range as boundary points
+    VkDeviceSize memory_block_size = g_allocator.get().getLimits().nonCoherentAtomSize;
+    VkDeviceSize start = roundDownToMemoryBlock(m_memory.offset + m_buffer_offsets[buffer_index] + offset, memory_block_size);
+    VkDeviceSize end = roundUpToMemoryBlock(m_memory.offset + m_buffer_offsets[buffer_index] + offset + size, memory_block_size);
+    return VkMappedMemoryRange{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, m_memory.memory, start, end - start};
+}
+
+
+
+ReadbackBufferMemoryObject::ReadbackBufferMemoryObject(const vector<Buffer>& buffers, const MemoryTypeRequest& request) :
+    SharedBufferMemoryObject(buffers, request)
+{}
 
 
 
-DeviceLocalBufferMemoryObject::DeviceLocalBufferMemoryObject(const vector<Buffer>& buffers, VkMemoryPropertyFlags memory_properties) :
-    BufferMemoryObject(buffers, memory_properties)
+DeviceLocalBufferMemoryObject::DeviceLocalBufferMemoryObject(const vector<Buffer>& buffers, const MemoryTypeRequest& request) :
+    BufferMemoryObject(buffers, request)
 {}
@@ -2,6 +2,7 @@
 #define BUFFER_H
 
 #include "../00_base/vulkan_base.h"
+#include "../01_device/memory_block.h"
 #include "mixed_buffer.h"
 
 
@@ -46,6 +47,8 @@ class Buffer{
     VkBuffer m_buffer;
     //size in bytes
     VkDeviceSize m_size;
+    //info the buffer was created with, pointers are cleared as they may not be valid after construction. Used to create a copy when relocating the buffer
+    VkBufferCreateInfo m_create_info;
 public:
     //construct invalid buffer
     Buffer();
@@ -74,6 +77,12 @@ public:
     //Get size of buffer in bytes
     VkDeviceSize getSize() const;
 
+    //Get the info the buffer was created with, without pNext and queue family indices
+    const VkBufferCreateInfo& getCreateInfo() const;
+
+    //Replace the handle with a copy created from getCreateInfo() and bound to other memory, used when relocating. The old handle isn't destroyed
+    void rebind(VkBuffer buffer);
+
     operator const VkBuffer&() const;
 };
 
@@ -98,34 +107,126 @@ public:
  */
 class BufferMemoryObject{
 protected:
-    VkDeviceMemory m_memory;
-    //holds offset from start of memory for each buffer, and last element as memory size
+    MemoryAllocation m_memory;
+    //holds offset from start of the allocation for each buffer, and last element as memory size
     vector<uint32_t> m_buffer_offsets;
+    //alignment of the whole allocation
+    VkDeviceSize m_alignment;
 public:
-    //Allocate memory with given properties for each buffer
-    BufferMemoryObject(const vector<Buffer>& buffers, VkMemoryPropertyFlags memory_properties);
+    //Allocate memory for all buffers from the memory type that fits the request best. Passing just property flags picks any type that has them
+    BufferMemoryObject(const vector<Buffer>& buffers, const MemoryTypeRequest& request);
+
+    //Return the memory to the allocator. The buffers must not be used by the device anymore
+    void free();
+
+    //Get property flags of the memory type that was actually allocated, may contain more flags than requested
+    VkMemoryPropertyFlags getPropertyFlags() const;
+
+    //Get the allocation all buffers are bound to
+    const MemoryAllocation& getMemory() const;
+
+    //Get alignment of the whole allocation
+    VkDeviceSize getAlignment() const;
+
+    //Get offset of given buffer from the start of the allocation
+    VkDeviceSize getBufferOffset(int buffer_index) const;
+
+    /**
+     * Replace the allocation with another one of the same size and memory type, used when relocating. The old allocation is released after the current frame.
+     * Mapped memory isn't remapped, so memory of shared objects must not be rebound
+     * @param memory the new allocation, buffers are expected to be bound to it at their offsets already
+     */
+    void rebind(const MemoryAllocation& memory);
 };
 
 
 /**
  * SharedBufferMemoryObject
  *  - Holds memory for all buffers, automatically maps it, so it can be uploaded without vulkan functions
+ *  - Knows the properties of the memory type it got - flushes and invalidations are skipped if the memory is host coherent
  */
 class SharedBufferMemoryObject : public BufferMemoryObject{
     //mapped memory pointer
     void* m_data;
+    //true if the memory is host coherent, and doesn't have to be flushed or invalidated
+    bool m_coherent;
+    //ranges written by write() that weren't flushed yet
+    vector<VkMappedMemoryRange> m_pending_flushes;
 public:
-    //Allocate memory for given buffers. memory_properties must contain VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT for mapping to work
-    SharedBufferMemoryObject(const vector<Buffer>& buffers, VkMemoryPropertyFlags memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    /**
+     * Allocate memory for given buffers.
+     * @param buffers the buffers to allocate memory for
+     * @param request required properties must contain VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT for mapping to work. Upload memory by default - coherent if available, so writes don't need flushing
+     */
+    SharedBufferMemoryObject(const vector<Buffer>& buffers, const MemoryTypeRequest& request = MemoryTypeRequest(MEMORY_USAGE_UPLOAD));
     
     /**
-     * Copy data to buffer.
+     * Copy data to buffer and flush it.
      * @param buffer_index index into buffer array passed to constructor to copy data into
      * @param data pointer to bytes to copy
      * @param size number of bytes to copy
      * @param offset offset in target buffer
      */
     void copyToBuffer(int buffer_index, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+    /**
+     * Copy data to buffer without flushing. The range is flushed together with all other pending ones by flushPending().
+     * @param buffer_index index into buffer array passed to constructor to copy data into
+     * @param data pointer to bytes to copy
+     * @param size number of bytes to copy
+     * @param offset offset in target buffer
+     */
+    void write(int buffer_index, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+    //Flush all ranges written by write() since the last call using one vkFlushMappedMemoryRanges call
+    void flushPending();
+
+    /**
+     * Invalidate a range of buffer memory, then copy data from it. Used to read data written by the GPU.
+     * @param buffer_index index into buffer array passed to constructor to copy data from
+     * @param data pointer to copy data to
+     * @param size number of bytes to copy
+     * @param offset offset in source buffer
+     */
+    void copyFromBuffer(int buffer_index, void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+    //Get pointer to the mapped memory of given buffer. Data written through it has to be flushed before the GPU uses it
+    uint8_t* getData(int buffer_index);
+
+    /**
+     * Flush a range of buffer memory, making writes through the mapped pointer visible to the GPU.
+     * @param buffer_index index into buffer array passed to constructor
+     * @param offset offset of the range in the buffer
+     * @param size size of the range in bytes
+     */
+    void flush(int buffer_index, VkDeviceSize offset, VkDeviceSize size);
+
+    /**
+     * Invalidate a range of buffer memory, making GPU writes visible through the mapped pointer.
+     * @param buffer_index index into buffer array passed to constructor
+     * @param offset offset of the range in the buffer
+     * @param size size of the range in bytes
+     */
+    void invalidate(int buffer_index, VkDeviceSize offset, VkDeviceSize size);
+
+    //Invalidate the memory of all buffers using one vkInvalidateMappedMemoryRanges call
+    void invalidateAll();
+
+    //return true if the memory is host coherent
+    bool isCoherent() const;
+private:
+    //Get memory range covering given part of a buffer, rounded to nonCoherentAtomSize
+    VkMappedMemoryRange getMappedRange(int buffer_index, VkDeviceSize offset, VkDeviceSize size) const;
+};
+
+
+/**
+ * ReadbackBufferMemoryObject
+ *  - Shared memory for reading data written by the GPU. Prefers host cached memory, reading from uncached memory is very slow
+ */
+class ReadbackBufferMemoryObject : public SharedBufferMemoryObject{
+public:
+    ReadbackBufferMemoryObject(const vector<Buffer>& buffers, const MemoryTypeRequest& request = MemoryTypeRequest(MEMORY_USAGE_READBACK));
 };
 
 
@@ -135,7 +236,8 @@ public:
  */
 class DeviceLocalBufferMemoryObject : public BufferMemoryObject{
 public:
-    DeviceLocalBufferMemoryObject(const vector<Buffer>& buffers, VkMemoryPropertyFlags memory_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    DeviceLocalBufferMemoryObject(const vector<Buffer>& buffers,
+        const MemoryTypeRequest& request = MemoryTypeRequest(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, MEMORY_USAGE_GPU_ONLY));
 };
 
 #endif
\ No newline at end of file
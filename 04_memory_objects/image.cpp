@@ -3,6 +3,7 @@
 #include "../00_base/vulkan_enum_strings.h"
 #include "../01_device/allocator.h"
 #include "mixed_buffer.h"
+#include <algorithm>
 
 
 //sizes of each format in bytes
@@ -68,11 +69,15 @@ const Image& ImageView::getImage() const{
 
 
 //create invalid image
-Image::Image() : m_image(VK_NULL_HANDLE), m_type(VK_IMAGE_TYPE_MAX_ENUM), m_size{0, 0, 0}, m_format(VK_FORMAT_UNDEFINED), m_aspect(0)
-{}
+Image::Image() : m_image(VK_NULL_HANDLE), m_type(VK_IMAGE_TYPE_MAX_ENUM), m_size{0, 0, 0}, m_format(VK_FORMAT_UNDEFINED), m_aspect(0), m_create_info{}
+{
+    m_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+}
 Image::Image(VkImage image, const VkImageCreateInfo& info) :
-    m_image(image), m_type(info.imageType), m_size(info.extent), m_format(info.format)
+    m_image(image), m_type(info.imageType), m_size(info.extent), m_format(info.format), m_create_info(info)
 {
+    m_create_info.pNext = nullptr;
+    m_create_info.pQueueFamilyIndices = nullptr;
     //derive image aspect from its' format
     if (m_format == VK_FORMAT_S8_UINT) m_aspect = VK_IMAGE_ASPECT_STENCIL_BIT;
     else if (m_format == VK_FORMAT_D16_UNORM         || m_format == VK_FORMAT_X8_D24_UNORM_PACK32 || m_format == VK_FORMAT_D32_SFLOAT)           m_aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
@@ -135,6 +140,34 @@ VkMemoryRequirements Image::getMemoryRequirements() const{
     vkGetImageMemoryRequirements(g_device, m_image, &requirements);
     return requirements;
 }
+bool Image::prefersDedicatedAllocation() const{
+    //dedicated requirements are returned in the pNext chain of extended memory requirements
+    VkMemoryDedicatedRequirements dedicated{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS, nullptr, VK_FALSE, VK_FALSE};
+    VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicated, {}};
+    VkImageMemoryRequirementsInfo2 info{VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2, nullptr, m_image};
+    vkGetImageMemoryRequirements2(g_device, &info, &requirements);
+    return dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation;
+}
+vector<VkSparseImageMemoryRequirements> Image::getSparseMemoryRequirements() const{
+    //get requirement count, then all requirements
+    uint32_t count;
+    vkGetImageSparseMemoryRequirements(g_device, m_image, &count, nullptr);
+    vector<VkSparseImageMemoryRequirements> requirements(count);
+    vkGetImageSparseMemoryRequirements(g_device, m_image, &count, requirements.data());
+    return requirements;
+}
+uint32_t Image::getMipLevels() const{
+    return m_create_info.mipLevels;
+}
+uint32_t Image::getArrayLayers() const{
+    return m_create_info.arrayLayers;
+}
+const VkImageCreateInfo& Image::getCreateInfo() const{
+    return m_create_info;
+}
+void Image::rebind(VkImage image){
+    m_image = image;
+}
 
 
 
@@ -152,11 +185,13 @@ vector<const T*> vectorOfPointers(const vector<T>& vec){
 
 
 
-ImageMemoryObject::ImageMemoryObject() : m_memory{VK_NULL_HANDLE}
+ImageMemoryObject::ImageMemoryObject() : m_memory(), m_alignment(1)
 {}
 ImageMemoryObject::ImageMemoryObject(const vector<Image>& images, VkMemoryPropertyFlagBits memory_properties) : ImageMemoryObject(vectorOfPointers(images), memory_properties)
 {}
-ImageMemoryObject::ImageMemoryObject(const vector<const Image*>& images, VkMemoryPropertyFlagBits memory_properties){
+ImageMemoryObject::ImageMemoryObject(const vector<const Image*>& images, VkMemoryPropertyFlagBits memory_properties) : m_memory(), m_alignment(1){
+    //images are accessed only by the GPU, don't waste host visible device local memory on them
+    MemoryTypeRequest request(memory_properties, 0, 0, MEMORY_USAGE_GPU_ONLY);
     //total size in bytes
     //VkDeviceSize total_size = 0;
     //all usable memory types
@@ -164,23 +199,68 @@ ImageMemoryObject::ImageMemoryObject(const vector<const Image*>& images, VkMemor
     //one offset per image, last one represents size of all in bytes
     vector<VkDeviceSize> offsets(images.size() + 1, 0);
     offsets[0] = 0;
+    //alignment of the whole allocation, the largest one required by any of the images
+    VkDeviceSize alignment = 1;
     VkMemoryRequirements memory_requirements;
+    //which images got dedicated memory
+    vector<bool> dedicated(images.size(), false);
     for (uint32_t i = 0; i < images.size(); i++)
     {
         //get image memory requirements - size, required alignment, memory type
         memory_requirements = images[i]->getMemoryRequirements();
+        //images the driver wants in separate memory get their own allocation and take no space in the shared one
+        if (images[i]->prefersDedicatedAllocation()){
+            MemoryAllocation allocation = g_allocator.get().allocateDedicatedMemory(memory_requirements.size, memory_requirements.memoryTypeBits, request, *images[i]);
+            VkResult result = vkBindImageMemory(g_device, *images[i], allocation.memory, allocation.offset);
+            DEBUG_CHECK("Image memory binding", result)
+            m_dedicated_memory.push_back(allocation);
+            dedicated[i] = true;
+            offsets[i + 1] = offsets[i];
+            continue;
+        }
         offsets[i] = roundUpToMemoryBlock(offsets[i], memory_requirements.alignment);
+        alignment = std::max(alignment, memory_requirements.alignment);
         //mark all unusable memory types
         memory_type_bits &= memory_requirements.memoryTypeBits;
         offsets[i+1] = offsets[i] + memory_requirements.size;
     }
-    offsets.back() = roundUpToMemoryBlock(offsets.back(), memory_requirements.alignment);
+    offsets.back() = roundUpToMemoryBlock(offsets.back(), alignment);
+    //remember where each image lies, so the images can be relocated later
+    m_offsets.assign(offsets.begin(), offsets.end() - 1);
+    for (uint32_t i = 0; i < images.size(); i++){
+        if (dedicated[i]) m_offsets[i] = VK_WHOLE_SIZE;
+    }
+    m_alignment = alignment;
+    //all images have dedicated memory
+    if (offsets.back() == 0) return;
     //allocate memory for all images
-    m_memory = g_allocator.get().allocateMemory(offsets.back(), memory_type_bits, memory_properties);
-    //bind allocated memory to all images
+    m_memory = g_allocator.get().allocateMemory(offsets.back(), memory_type_bits, request, alignment, MEMORY_RESOURCE_OPTIMAL);
+    //bind allocated memory to all images, image offsets are relative to the allocation start
     for (uint32_t i = 0; i < images.size(); i++){
-        VkResult result = vkBindImageMemory(g_device, *images[i], m_memory, offsets[i]);
+        if (dedicated[i]) continue;
+        VkResult result = vkBindImageMemory(g_device, *images[i], m_memory.memory, m_memory.offset + offsets[i]);
         DEBUG_CHECK("Image memory binding", result)
     }
 }
+void ImageMemoryObject::free(){
+    g_allocator.get().free(m_memory);
+    m_memory = MemoryAllocation();
+    for (const MemoryAllocation& allocation : m_dedicated_memory){
+        g_allocator.get().free(allocation);
+    }
+    m_dedicated_memory.clear();
+}
+const MemoryAllocation& ImageMemoryObject::getMemory() const{
+    return m_memory;
+}
+VkDeviceSize ImageMemoryObject::getAlignment() const{
+    return m_alignment;
+}
+VkDeviceSize ImageMemoryObject::getImageOffset(int image_index) const{
+    return m_offsets[image_index];
+}
+void ImageMemoryObject::rebind(const MemoryAllocation& memory){
+    g_allocator.get().releaseMemory(m_memory);
+    m_memory = memory;
+}
 
@@ -2,6 +2,7 @@
 #define IMAGE_H
 
 #include "../00_base/vulkan_base.h"
+#include "../01_device/memory_block.h"
 
 /**
  * Represents image format.
@@ -123,6 +124,8 @@ class Image{
 
     //Whether the image is depth, stencil, color, ...
     VkImageAspectFlags m_aspect;
+    //info the image was created with, pointers are cleared as they may not be valid after construction. Used to create a copy when relocating the image
+    VkImageCreateInfo m_create_info;
 public:
     //creates an invalid image, used by some classes
     Image();
@@ -161,6 +164,17 @@ public:
     VkDeviceSize getSizeInBytes() const;
     //Get memory requirements. This is used when allocating memory for the image.
     VkMemoryRequirements getMemoryRequirements() const;
+    //Return true if the driver prefers or requires the image to have a separate memory allocation, usually true for large render targets
+    bool prefersDedicatedAllocation() const;
+    //Get sparse memory requirements, one for each aspect (and metadata) of a sparse image - page size and mip tail layout
+    vector<VkSparseImageMemoryRequirements> getSparseMemoryRequirements() const;
+    //Get the number of mipmap levels and array layers of the image
+    uint32_t getMipLevels() const;
+    uint32_t getArrayLayers() const;
+    //Get the info the image was created with, without pNext and queue family indices
+    const VkImageCreateInfo& getCreateInfo() const;
+    //Replace the handle with a copy created from getCreateInfo() and bound to other memory, used when relocating. The old handle isn't destroyed
+    void rebind(VkImage image);
 };
 
 
@@ -192,14 +206,39 @@ vector<T*> vectorOfPointers(vector<T>& vec);
 /**
  * ImageMemoryObject
  *  - Is used to allocate memory with given properties for each of the images given
+ *  - Images are packed into one allocation, except for those for which the driver prefers a dedicated allocation
  */
 class ImageMemoryObject{
-    VkDeviceMemory m_memory;
+    MemoryAllocation m_memory;
+    //one allocation for each image that uses dedicated memory
+    vector<MemoryAllocation> m_dedicated_memory;
+    //offset of each image from the start of m_memory, images with dedicated memory are marked by VK_WHOLE_SIZE
+    vector<VkDeviceSize> m_offsets;
+    //alignment of m_memory
+    VkDeviceSize m_alignment;
 public:
     //create invalid memory object
     ImageMemoryObject();
     ImageMemoryObject(const vector<Image>& images, VkMemoryPropertyFlagBits memory_properties);
     ImageMemoryObject(const vector<const Image*>& images, VkMemoryPropertyFlagBits memory_properties);
+
+    //Return the memory to the allocator. The images must not be used by the device anymore
+    void free();
+
+    //Get the allocation shared by all images without dedicated memory
+    const MemoryAllocation& getMemory() const;
+
+    //Get alignment of the shared allocation
+    VkDeviceSize getAlignment() const;
+
+    //Get offset of given image from the start of the shared allocation, VK_WHOLE_SIZE if the image has dedicated memory
+    VkDeviceSize getImageOffset(int image_index) const;
+
+    /**
+     * Replace the shared allocation with another one of the same size and memory type, used when relocating. The old allocation is released after the current frame
+     * @param memory the new allocation, images without dedicated memory are expected to be bound to it at their offsets already
+     */
+    void rebind(const MemoryAllocation& memory);
 };
 
 #endif
\ No newline at end of file
@@ -22,6 +22,11 @@ ImageInfo& ImageInfo::setFlags(VkImageCreateFlags flags){
     m_info.flags = flags;
     return *this;
 }
+ImageInfo& ImageInfo::setSparse(bool residency){
+    m_info.flags |= VK_IMAGE_CREATE_SPARSE_BINDING_BIT;
+    if (residency) m_info.flags |= VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+    return *this;
+}
 ImageInfo& ImageInfo::setMipmapCount(uint32_t mipmap_count){
     m_info.mipLevels = mipmap_count;
     return *this;
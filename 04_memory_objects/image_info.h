@@ -54,6 +54,13 @@ public:
      */
     ImageInfo& setFlags(VkImageCreateFlags flags);
 
+    /**
+     * Create the image as a sparse resource - memory is bound to it later, page by page, using vkQueueBindSparse. See VirtualTexture.
+     * Requires the sparseBinding device feature, and sparseResidencyImage2D/3D for partially resident images.
+     * @param residency if true, the image may be only partially resident, otherwise it has to be fully bound before being used
+     */
+    ImageInfo& setSparse(bool residency = true);
+
     //Set the number of mipmaps the image should have    
     ImageInfo& setMipmapCount(uint32_t mipmap_count);
 
@@ -1,41 +1,248 @@
 #include "local_object_creator.h"
 
 #include "../03_commands/command_buffer.h"
-#include "../03_commands/command_pool.h"
 #include "image.h"
 
 
-LocalObjectCreator::LocalObjectCreator(Queue& transfer_queue, VkDeviceSize staging_buffer_size) : m_staging_buffer_size(staging_buffer_size),
-    m_staging_buffer(BufferInfo(staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT).create()), m_staging_buffer_memory({m_staging_buffer}),
-    //command pool - make buffers individually free-able
-    m_transfer_command_buffer(CommandPoolInfo{transfer_queue.getFamilyIndex(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT}.create().allocateBuffer()),
-    m_transfer_queue(transfer_queue)
+UploadToken::UploadToken(uint64_t submission_) : submission(submission_)
 {}
 
-void LocalObjectCreator::copyToLocal(const vector<uint8_t>& data, Image& device_local_image, ImageState state, ImageState end_state){
-    copyToLocal(data.data(), data.size(), device_local_image, state, end_state);
+
+
+UploadSubmission::UploadSubmission(uint32_t transfer_family_index, uint32_t destination_family_index) :
+    pool(transfer_family_index), acquire_pool(), command_buffer(VK_NULL_HANDLE), fence(), staging_size(0), index(0),
+    acquire_command_buffer(VK_NULL_HANDLE), semaphore()
+{
+    if (destination_family_index != transfer_family_index) acquire_pool = unique_ptr<TransientCommandPool>(new TransientCommandPool(destination_family_index));
+}
+
+
+
+LocalObjectCreator::LocalObjectCreator(Queue& transfer_queue, VkDeviceSize staging_buffer_size) : LocalObjectCreator(transfer_queue, transfer_queue, staging_buffer_size)
+{}
+LocalObjectCreator::LocalObjectCreator(Queue& transfer_queue, Queue& destination_queue, VkDeviceSize staging_buffer_size) : m_staging_buffer_size(staging_buffer_size),
+    m_staging_buffer(BufferInfo(staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT).create()), m_staging_buffer_memory({m_staging_buffer}),
+    m_staging_head(0), m_staging_used(0), m_next_submission(1), m_completed_submission(0), m_recording(false), m_batching(false),
+    m_transfer_queue(transfer_queue), m_destination_queue(nullptr), m_consumer_stages(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT)
+{
+    //ownership has to be transferred only between different families
+    if (destination_queue.getFamilyIndex() != transfer_queue.getFamilyIndex()) m_destination_queue = &destination_queue;
+    //create transient command pools and a fence for each submission in flight. Acquire buffers are recorded on the destination family
+    m_submissions.reserve(UPLOADS_IN_FLIGHT);
+    for (uint32_t i = 0; i < UPLOADS_IN_FLIGHT; i++){
+        m_submissions.push_back(UploadSubmission(transfer_queue.getFamilyIndex(), destination_queue.getFamilyIndex()));
+    }
 }
+
 void LocalObjectCreator::copyToLocal(const uint8_t* data_bytes, uint32_t data_size_bytes, Image& device_local_image, ImageState state, ImageState end_state){
-    //images cannot be copied as multiple parts - if the size to copy is larger than staging buffer, print error
-    if (data_size_bytes > m_staging_buffer_size) PRINT_ERROR("Trying to copy data of larger size than staging buffer. Staging buffer size: " << m_staging_buffer_size << ", data size: " << data_size_bytes);
-    //if the data to copy and target image have different sizes, print warning
-    if (data_size_bytes != device_local_image.getSizeInBytes()) PRINT_WARN("The data to copy and the target image have different sizes. Data size: " << data_size_bytes << ", Image size: " << device_local_image.getSizeInBytes()) 
-    //copy data to staging buffer
-    m_staging_buffer_memory.copyToBuffer(0, data_bytes, data_size_bytes);
-
-    //record command buffer for transfer
-    m_transfer_command_buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-    //copy to image command
-    m_transfer_command_buffer.cmdCopyToTexture(m_staging_buffer, device_local_image, state, end_state);
-    m_transfer_command_buffer.endRecord();
-
-    //synchronization for copy operation with one end fence
+    wait(copyToLocalAsync(data_bytes, data_size_bytes, device_local_image, state, end_state));
+}
+UploadToken LocalObjectCreator::copyToLocalAsync(const uint8_t* data_bytes, uint32_t data_size_bytes, Image& device_local_image, ImageState state, ImageState end_state){
+    //if the data to copy is smaller than the target image, print error and don't copy anything
+    if (data_size_bytes < device_local_image.getSizeInBytes()){
+        PRINT_ERROR("The data to copy is smaller than the target image. Data size: " << data_size_bytes << ", Image size: " << device_local_image.getSizeInBytes())
+        return lastToken();
+    }
+    //if the data to copy is larger than the target image, print warning, only the image size will be copied
+    if (data_size_bytes != device_local_image.getSizeInBytes()) PRINT_WARN("The data to copy and the target image have different sizes. Data size: " << data_size_bytes << ", Image size: " << device_local_image.getSizeInBytes())
+
+    const VkExtent3D& size = device_local_image.getSize();
+    VkDeviceSize texel_size = device_local_image.getFormat().getSize();
+    VkExtent3D chunk = getImageChunkExtent(device_local_image);
+    ImageState transfer_state{IMAGE_TRANSFER_DST};
+    //move the image to transfer layout before the first region is copied
+    if (state != transfer_state){
+        currentCommandBuffer().cmdBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, device_local_image.createMemoryBarrier(state, transfer_state));
+    }
+    //go through all regions - slices, then rows, then texels in a row
+    for (uint32_t z = 0; z < size.depth; z += chunk.depth){
+        for (uint32_t y = 0; y < size.height; y += chunk.height){
+            for (uint32_t x = 0; x < size.width; x += chunk.width){
+                //clip the region to the image size
+                VkExtent3D extent{std::min(chunk.width, size.width - x), std::min(chunk.height, size.height - y), std::min(chunk.depth, size.depth - z)};
+                VkDeviceSize region_size = texel_size * extent.width * extent.height * extent.depth;
+                //regions are continuous in the data, so the offset of the first texel is enough
+                VkDeviceSize data_offset = texel_size * ((1ULL * z * size.height + y) * size.width + x);
+                //buffer offset of image copy must be a multiple of both 4 and texel size
+                VkDeviceSize staging_offset = reserveStaging(region_size, 4 * texel_size);
+                m_staging_buffer_memory.write(0, &data_bytes[data_offset], region_size, staging_offset);
+                currentCommandBuffer().cmdCopyToTextureRegion(m_staging_buffer, device_local_image, staging_offset, VkOffset3D{(int32_t) x, (int32_t) y, (int32_t) z}, extent);
+                //if this was the last region, move the image to the end state
+                bool last = (x + extent.width == size.width) && (y + extent.height == size.height) && (z + extent.depth == size.depth);
+                if (last && transfersOwnership()){
+                    //release the image to the destination family, the layout transition is part of both release and acquire barrier
+                    uint32_t src_family = m_transfer_queue.getFamilyIndex(), dst_family = m_destination_queue->getFamilyIndex();
+                    currentCommandBuffer().cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, device_local_image.createMemoryBarrier(transfer_state, end_state, src_family, dst_family));
+                    //the acquire barrier doesn't need any source access, the semaphore makes the writes available
+                    VkImageMemoryBarrier acquire = device_local_image.createMemoryBarrier(transfer_state, end_state, src_family, dst_family);
+                    acquire.srcAccessMask = 0;
+                    currentSubmission().acquire_image_barriers.push_back(acquire);
+                }else if (last && end_state != transfer_state){
+                    //the transfer queue may not support graphics stages, wait at the stages set by the user
+                    currentCommandBuffer().cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, m_consumer_stages, device_local_image.createMemoryBarrier(transfer_state, end_state));
+                }
+                //submit the region right away, so the GPU can start copying. During a batch, the copies are submitted together in endBatch()
+                if (!m_batching) submit();
+            }
+        }
+    }
+    return lastToken();
+}
+void LocalObjectCreator::beginBatch(){
+    if (m_batching) PRINT_WARN("Batch already started")
+    m_batching = true;
+}
+UploadToken LocalObjectCreator::endBatch(){
+    if (!m_batching) PRINT_WARN("Ending batch that wasn't started")
+    m_batching = false;
+    return submit();
+}
+bool LocalObjectCreator::isComplete(UploadToken token){
+    //the submission is still being recorded
+    if (token.submission >= m_next_submission) return false;
+    //go through submissions in flight in order, retire all that have finished already
+    while (m_completed_submission < token.submission){
+        if (!m_submissions[(m_completed_submission + 1) % UPLOADS_IN_FLIGHT].fence.waitFor(0)) return false;
+        retire(m_completed_submission + 1);
+    }
+    return true;
+}
+void LocalObjectCreator::wait(UploadToken token){
+    //if the upload wasn't submitted yet, do it now
+    if (token.submission >= m_next_submission) submit();
+    retire(token.submission);
+}
+void LocalObjectCreator::waitAll(){
+    submit();
+    retire(m_next_submission - 1);
+}
+void LocalObjectCreator::setConsumerStages(VkPipelineStageFlags stages){
+    m_consumer_stages = stages;
+}
+VkDeviceSize LocalObjectCreator::getChunkSize() const{
+    return std::max<VkDeviceSize>(m_staging_buffer_size / UPLOADS_IN_FLIGHT, 1);
+}
+VkExtent3D LocalObjectCreator::getImageChunkExtent(const Image& image) const{
+    const VkExtent3D& size = image.getSize();
+    //how many texels fit into one chunk, at least one
+    VkDeviceSize texels = std::max<VkDeviceSize>(getChunkSize() / image.getFormat().getSize(), 1);
+    VkDeviceSize slice_texels = 1ULL * size.width * size.height;
+    //whole slices fit - copy as many as possible at once
+    if (texels >= slice_texels) return VkExtent3D{size.width, size.height, (uint32_t) std::min<VkDeviceSize>(texels / slice_texels, size.depth)};
+    //whole rows fit - copy multiple rows of one slice
+    if (texels >= size.width) return VkExtent3D{size.width, (uint32_t) (texels / size.width), 1};
+    //copy a part of one row
+    return VkExtent3D{(uint32_t) texels, 1, 1};
+}
+VkDeviceSize LocalObjectCreator::reserveStaging(VkDeviceSize size, VkDeviceSize alignment){
+    //if the data can never fit, print error and fail
+    if (size > m_staging_buffer_size){
+        PRINT_ERROR("Trying to copy data of larger size than staging buffer. Staging buffer size: " << m_staging_buffer_size << ", data size: " << size)
+        throw std::runtime_error("Staging buffer too small");
+    }
+    while (true){
+        //if nothing is using the ring, start from the beginning again
+        if (m_staging_used == 0) m_staging_head = 0;
+        //align the offset, if the data doesn't fit before the end of the ring, wrap around and waste the remaining space
+        VkDeviceSize offset = roundUpToMemoryBlock(m_staging_head, alignment);
+        VkDeviceSize padding = offset - m_staging_head;
+        if (offset + size > m_staging_buffer_size){
+            offset = 0;
+            padding = m_staging_buffer_size - m_staging_head;
+        }
+        VkDeviceSize used = padding + size;
+        //if there is enough space, reserve it for the current submission
+        if (m_staging_used + used <= m_staging_buffer_size){
+            currentCommandBuffer();
+            m_submissions[m_next_submission % UPLOADS_IN_FLIGHT].staging_size += used;
+            m_staging_used += used;
+            m_staging_head = offset + size;
+            return offset;
+        }
+        //not enough space - wait for the oldest submission, or submit the current one if none are in flight
+        if (m_completed_submission + 1 < m_next_submission){
+            retire(m_completed_submission + 1);
+        }else{
+            submit();
+        }
+    }
+}
+CommandBuffer& LocalObjectCreator::currentCommandBuffer(){
+    UploadSubmission& current = currentSubmission();
+    if (!m_recording){
+        //if the command buffer is still in flight from an older submission, wait for it
+        if (current.index != 0) retire(current.index);
+        //buffers of the previous use finished, reset both pools at once instead of each buffer
+        current.pool.reset();
+        if (current.acquire_pool) current.acquire_pool->reset();
+        current.command_buffer = current.pool.allocateBuffer();
+        current.command_buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        m_recording = true;
+    }
+    return current.command_buffer;
+}
+UploadToken LocalObjectCreator::submit(){
+    //if nothing was recorded, return token of the last submission
+    if (!m_recording) return UploadToken(m_next_submission - 1);
+    UploadSubmission& current = currentSubmission();
+    //make all staging data written for this submission visible to the GPU
+    m_staging_buffer_memory.flushPending();
+    current.command_buffer.endRecord();
     SubmitSynchronization transfer_synchronization;
-    transfer_synchronization.setEndFence(Fence());
-    //submit task to the queue and wait for it to finish
-    m_transfer_queue.submit(m_transfer_command_buffer, transfer_synchronization);
-    //wait for it to finish
-    transfer_synchronization.waitFor(A_SHORT_WHILE);
-    //reset recorded buffer
-    m_transfer_command_buffer.resetBuffer(false);
+    if (current.acquire_buffer_barriers.empty() && current.acquire_image_barriers.empty()){
+        //submit the command buffer with the submission fence
+        transfer_synchronization.setEndFence(current.fence);
+        m_transfer_queue.submit(current.command_buffer, transfer_synchronization);
+    }else{
+        //submit the copies, signal the semaphore when they finish
+        transfer_synchronization.addEndSemaphore(current.semaphore);
+        m_transfer_queue.submit(current.command_buffer, transfer_synchronization);
+        //record all acquire barriers into one command buffer, later work on the destination queue waits for them
+        current.acquire_command_buffer = current.acquire_pool->allocateBuffer();
+        current.acquire_command_buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        if (!current.acquire_buffer_barriers.empty()) current.acquire_command_buffer.cmdBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, current.acquire_buffer_barriers);
+        if (!current.acquire_image_barriers.empty()) current.acquire_command_buffer.cmdBarrier(m_consumer_stages, m_consumer_stages, current.acquire_image_barriers);
+        current.acquire_command_buffer.endRecord();
+        current.acquire_buffer_barriers.clear();
+        current.acquire_image_barriers.clear();
+        //the acquire waits for the copies, the fence is signaled when the resources are usable on the destination queue
+        SubmitSynchronization acquire_synchronization;
+        acquire_synchronization.addStartSemaphore(current.semaphore, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        acquire_synchronization.setEndFence(current.fence);
+        m_destination_queue->submit(current.acquire_command_buffer, acquire_synchronization);
+    }
+    current.index = m_next_submission++;
+    m_recording = false;
+    return UploadToken(current.index);
+}
+UploadSubmission& LocalObjectCreator::currentSubmission(){
+    return m_submissions[m_next_submission % UPLOADS_IN_FLIGHT];
+}
+bool LocalObjectCreator::transfersOwnership() const{
+    return m_destination_queue != nullptr;
+}
+void LocalObjectCreator::releaseOwnership(Buffer& buffer){
+    if (!transfersOwnership()) return;
+    uint32_t src_family = m_transfer_queue.getFamilyIndex(), dst_family = m_destination_queue->getFamilyIndex();
+    //release - make transfer writes available, destination access is ignored
+    currentCommandBuffer().cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, buffer.createMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, 0, src_family, dst_family));
+    //acquire - how the buffer will be used is unknown, make it visible to all reads and writes
+    currentSubmission().acquire_buffer_barriers.push_back(buffer.createMemoryBarrier(0, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, src_family, dst_family));
+}
+UploadToken LocalObjectCreator::lastToken() const{
+    return UploadToken(m_recording ? m_next_submission : m_next_submission - 1);
+}
+void LocalObjectCreator::retire(uint64_t submission){
+    //submissions finish in order, wait for each one up to the given index
+    while (m_completed_submission < submission){
+        UploadSubmission& oldest = m_submissions[(m_completed_submission + 1) % UPLOADS_IN_FLIGHT];
+        //wait a while for the transfer to finish, print error if it took too long
+        if (!oldest.fence.waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for upload expired")
+        oldest.fence.reset();
+        //free the staging space used by the submission
+        m_staging_used -= oldest.staging_size;
+        oldest.staging_size = 0;
+        oldest.index = 0;
+        m_completed_submission++;
+    }
 }
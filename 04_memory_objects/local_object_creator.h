@@ -3,9 +3,13 @@
 
 #include "../01_device/device.h"
 #include "../03_commands/command_buffer.h"
+#include "../03_commands/command_pool.h"
 #include "../03_commands/synchronization.h"
 #include "buffer_info.h"
 #include "buffer.h"
+#include <memory>
+
+using std::unique_ptr;
 
 /**
  * BufferUsageInfo
@@ -27,10 +31,59 @@ class Queue;
 class Image;
 
 
+//how many uploads can be executed on the GPU at once, while the CPU prepares the next one
+const uint32_t UPLOADS_IN_FLIGHT = 3;
+
+
+/**
+ * UploadToken
+ *  - Identifies a submitted upload, can be used to check whether it has finished without blocking
+ */
+class UploadToken{
+public:
+    //index of the last submission the upload was a part of
+    uint64_t submission;
+    UploadToken(uint64_t submission_ = 0);
+};
+
+
+/**
+ * UploadSubmission
+ *  - One command buffer and fence used by the LocalObjectCreator for one submission of copy commands
+ *  - When uploading on a dedicated transfer queue, holds the acquire command buffer for the destination queue as well
+ */
+class UploadSubmission{
+public:
+    //transient pools of the submission on the transfer and destination families, reset as a whole before each reuse.
+    //The destination pool exists only when ownership is transferred, nullptr otherwise
+    TransientCommandPool pool;
+    unique_ptr<TransientCommandPool> acquire_pool;
+    CommandBuffer command_buffer;
+    //signaled when the copy commands finish, or when the acquire command buffer finishes when ownership is transferred
+    Fence fence;
+    //number of staging buffer bytes used by this submission, including padding when the staging ring wraps around
+    VkDeviceSize staging_size;
+    //index of the submission, 0 if the submission isn't in flight
+    uint64_t index;
+
+    //command buffer submitted to the destination queue, acquires ownership of all resources released by command_buffer
+    CommandBuffer acquire_command_buffer;
+    //signaled by the copy commands, waited for by the acquire command buffer
+    Semaphore semaphore;
+    //barriers to record into the acquire command buffer
+    vector<VkBufferMemoryBarrier> acquire_buffer_barriers;
+    vector<VkImageMemoryBarrier> acquire_image_barriers;
+    //create the submission, the acquire pool is created only if the families differ
+    UploadSubmission(uint32_t transfer_family_index, uint32_t destination_family_index);
+};
+
+
 /**
  * LocalObjectCreator
  *  - class responsible for uploading data to buffers and images on the GPU
  *  - can create buffers as well
+ *  - the staging buffer is used as a ring, up to UPLOADS_IN_FLIGHT submissions can be executed while the CPU fills the next part of the ring
+ *  - if a destination queue from a different family is given, copies run on the transfer queue and ownership of each resource is moved to the destination family automatically
  */
 class LocalObjectCreator{
     //size of staging buffer in bytes
@@ -39,18 +92,45 @@ class LocalObjectCreator{
     Buffer m_staging_buffer;
     //memory object for the staging buffer
     SharedBufferMemoryObject m_staging_buffer_memory;
-    //command buffer for transfer command
-    CommandBuffer m_transfer_command_buffer;
+    //offset in the staging buffer where the next data will be written
+    VkDeviceSize m_staging_head;
+    //number of staging buffer bytes used by submissions that haven't finished yet
+    VkDeviceSize m_staging_used;
+    //command buffers and fences, used in a circle
+    vector<UploadSubmission> m_submissions;
+    //index of the submission currently being recorded. Indices start at 1
+    uint64_t m_next_submission;
+    //all submissions with index lower or equal to this one have finished
+    uint64_t m_completed_submission;
+    //true if the current submission started recording
+    bool m_recording;
+    //true between beginBatch() and endBatch(), copies are recorded into one submission instead of being submitted right away
+    bool m_batching;
     //the queue to upload transfers to
     Queue& m_transfer_queue;
+    //the queue that will use uploaded resources, nullptr if it is in the same family as the transfer queue and no ownership transfer is needed
+    Queue* m_destination_queue;
+    //stages that first use uploaded images on the queue that owns them afterwards, the last barrier of an upload waits for the copies before them
+    VkPipelineStageFlags m_consumer_stages;
 public:
     /**
      * Create a new LocalObjectCreator.
      * @param transfer_queue the queue to use for transfering data between cpu and gpu
-     * @param staging_buffer_size the size, in bytes, to use for staging buffer. 1024 by default, good to increase if large textures or buffers will be copied.
+     * @param staging_buffer_size the size, in bytes, to use for staging buffer. 1024 by default. Data of any size is copied in chunks, a few megabytes are enough for large textures.
      */
     LocalObjectCreator(Queue& transfer_queue, VkDeviceSize staging_buffer_size = 1024u);
 
+    /**
+     * Create a new LocalObjectCreator that uploads on a dedicated transfer queue, so uploads can overlap work on the destination queue.
+     * Each uploaded resource is released by the transfer queue family, and acquired on the destination queue after the transfer signals a semaphore.
+     * Work submitted to the destination queue afterwards can use the resources without additional synchronization.
+     * Images should be in the IMAGE_NEWLY_CREATED state and buffers should be overwritten whole, their previous contents aren't transferred.
+     * @param transfer_queue the queue to record copies on, typically from a transfer-only family requested with QueueRequestInfo::prefer_dedicated
+     * @param destination_queue the queue that will use the uploaded resources
+     * @param staging_buffer_size the size, in bytes, to use for staging buffer
+     */
+    LocalObjectCreator(Queue& transfer_queue, Queue& destination_queue, VkDeviceSize staging_buffer_size = 1024u);
+
     /**
      * Copy buffer data to the GPU
      * @param data data to copy
@@ -62,52 +142,64 @@ public:
     }
 
     /**
-     * Copy buffer data to the GPU
+     * Copy buffer data to the GPU, wait until the copy finishes
      * @param data_typed pointer to data. Has to be of same type as data
      * @param data_size how many elements of above data should be copied
      * @param device_local_buffer buffer to copy to
      */
     template<typename T>
     void copyToLocal(const T* data_typed, VkDeviceSize data_size, Buffer& device_local_buffer){
+        wait(copyToLocalAsync(data_typed, data_size, device_local_buffer));
+    }
+
+    /**
+     * Start copying buffer data to the GPU, return a token that can be used to wait for the copy to finish.
+     * The data is copied into the staging buffer before returning, so it can be modified right after this call.
+     * @param data_typed pointer to data. Has to be of same type as data
+     * @param data_size how many elements of above data should be copied
+     * @param device_local_buffer buffer to copy to
+     * @param buffer_offset offset in bytes in the target buffer
+     */
+    template<typename T>
+    UploadToken copyToLocalAsync(const T* data_typed, VkDeviceSize data_size, Buffer& device_local_buffer, VkDeviceSize buffer_offset = 0){
         //compute data size in bytes
         data_size *= sizeof(T);
         //interpret data as an array of bytes
         const uint8_t* data = reinterpret_cast<const uint8_t*>(data_typed);
-        //Split data into multiple chunks, each one the size of staging buffer. Go through each chunk to copy:
-        for (VkDeviceSize data_offset = 0; data_offset < data_size; data_offset += m_staging_buffer_size){
-            //find end of range to copy - is either staging buffer size or end of buffer to copy from
-            uint32_t data_end = std::min(data_offset + m_staging_buffer_size, data_size);
-            
-            //since staging buffer is in shared memory, simply copy data to it
+        //chunks are smaller than the staging buffer, so the GPU can copy one while the CPU fills the next
+        VkDeviceSize chunk_size = getChunkSize();
+        //Split data into multiple chunks. Go through each chunk to copy:
+        for (VkDeviceSize data_offset = 0; data_offset < data_size; data_offset += chunk_size){
+            //find end of range to copy - is either chunk size or end of buffer to copy from
+            VkDeviceSize data_end = std::min(data_offset + chunk_size, data_size);
+            //find space in the staging buffer, then copy the data into it. All writes are flushed at once when submitting
+            VkDeviceSize staging_offset = reserveStaging(data_end - data_offset, 1);
             //          index of buffer to copy to
-            m_staging_buffer_memory.copyToBuffer(0, &data[data_offset], data_end - data_offset, data_offset);
-            
-            //record command buffer for copying data with only one copy command
-            m_transfer_command_buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            m_staging_buffer_memory.write(0, &data[data_offset], data_end - data_offset, staging_offset);
             //record copy command
-            m_transfer_command_buffer.cmdCopyFromBuffer(m_staging_buffer, device_local_buffer, data_end - data_offset, 0, data_offset);
-            m_transfer_command_buffer.endRecord();
-
-            //create synchronization for submitting buffer
-            SubmitSynchronization transfer_synchronization;
-            transfer_synchronization.setEndFence(Fence());
-            //submit command buffer to queue
-            m_transfer_queue.submit(m_transfer_command_buffer, transfer_synchronization);
-            //wait a while for the transfer to finish, print error if it took too long
-            transfer_synchronization.waitFor(A_SHORT_WHILE);
+            currentCommandBuffer().cmdCopyFromBuffer(m_staging_buffer, device_local_buffer, data_end - data_offset, staging_offset, buffer_offset + data_offset);
+            //after the last chunk, hand the buffer over to the destination queue
+            if (data_end == data_size) releaseOwnership(device_local_buffer);
+            //submit the chunk right away, so the GPU can start copying. During a batch, the copies are submitted together in endBatch()
+            if (!m_batching) submit();
         }
+        return lastToken();
     }
+
     /**
-     * Copy given data to an image on the GPU
-     * @param data data to copy
+     * Copy given data to an image on the GPU. Accepts Texture3D as well.
+     * @param data data to copy, tightly packed texels of the whole image
      * @param device_local_image the image to copy into
      * @param state the state the image is now in
      * @param end_state the state the image should be in after copying
      */
-    void copyToLocal(const vector<uint8_t>& data, Image& device_local_image, ImageState state, ImageState end_state);
+    template<typename T>
+    void copyToLocal(const vector<T>& data, Image& device_local_image, ImageState state, ImageState end_state){
+        copyToLocal(reinterpret_cast<const uint8_t*>(data.data()), data.size() * sizeof(T), device_local_image, state, end_state);
+    }
 
     /**
-     * Copy given data to an image on the GPU
+     * Copy given data to an image on the GPU, wait until the copy finishes
      * @param data_bytes pointer to data to copy
      * @param data_size_bytes how many bytes to copy
      * @param device_local_image the image to copy into
@@ -116,6 +208,41 @@ public:
      */
     void copyToLocal(const uint8_t* data_bytes, uint32_t data_size_bytes, Image& device_local_image, ImageState state, ImageState end_state);
 
+    /**
+     * Start copying given data to an image on the GPU, return a token that can be used to wait for the copy to finish.
+     * Images larger than one staging chunk are split into regions of whole slices, whole rows, or parts of one row, so any image can be copied through a small staging buffer.
+     * @param data_bytes pointer to data to copy
+     * @param data_size_bytes how many bytes to copy
+     * @param device_local_image the image to copy into
+     * @param state the state the image is now in
+     * @param end_state the state the image should be in after copying
+     */
+    UploadToken copyToLocalAsync(const uint8_t* data_bytes, uint32_t data_size_bytes, Image& device_local_image, ImageState state, ImageState end_state);
+
+    /**
+     * Start a batch of uploads. All following copies are recorded into one command buffer and submitted together by endBatch().
+     * Copies are submitted earlier only if the staging buffer fills up.
+     */
+    void beginBatch();
+
+    //Submit all copies recorded since beginBatch(), return a token of the whole batch
+    UploadToken endBatch();
+
+    //Return true if the upload with given token has finished. Doesn't block
+    bool isComplete(UploadToken token);
+
+    //Wait until the upload with given token finishes
+    void wait(UploadToken token);
+
+    //Submit all recorded copies and wait until all uploads finish
+    void waitAll();
+
+    /**
+     * Set stages that first use uploaded images, e.g. VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT for textures. They must be supported by the queue
+     * using the images - the destination queue, or the transfer queue without one. VK_PIPELINE_STAGE_ALL_COMMANDS_BIT by default
+     * @param stages the stages
+     */
+    void setConsumerStages(VkPipelineStageFlags stages);
 
     /**
      * Given default usage and data parameters, create buffers according to parameters and return them in a vector
@@ -129,12 +256,48 @@ public:
         //allocate space for buffers
         vector<Buffer> buffers;
         buffers.reserve(sizeof...(data_vectors));
-        //create buffers with given data
+        //create buffers with given data, all copies are submitted at once
+        beginBatch();
         createBuffersInternal(default_usage_flags, buffers, data_vectors...);
-        //return buffers
+        //wait for all copies to finish, then return buffers
+        wait(endBatch());
         return buffers;
     }
 private:
+    //Maximum size of one chunk of buffer or image data
+    VkDeviceSize getChunkSize() const;
+
+    //Return the extent of one image region that fits into a staging chunk. Regions are whole slices, whole rows, or parts of a row, so their data is always continuous
+    VkExtent3D getImageChunkExtent(const Image& image) const;
+
+    /**
+     * Find space in the staging ring, waiting for older submissions to finish if there isn't enough. Return offset of the reserved space.
+     * @param size number of bytes to reserve
+     * @param alignment the returned offset will be a multiple of this value
+     */
+    VkDeviceSize reserveStaging(VkDeviceSize size, VkDeviceSize alignment);
+
+    //Return the command buffer of the current submission, start recording it if it isn't recording yet
+    CommandBuffer& currentCommandBuffer();
+
+    //Return the submission currently being recorded
+    UploadSubmission& currentSubmission();
+
+    //return true if uploaded resources have to be moved to another queue family
+    bool transfersOwnership() const;
+
+    //If transferring ownership, record release barrier for the buffer and save the matching acquire barrier for the destination queue
+    void releaseOwnership(Buffer& buffer);
+
+    //Submit the current command buffer if anything was recorded into it. Return token of the submission
+    UploadToken submit();
+
+    //Return token of the last copy - the current submission if it is recording, the last submitted one otherwise
+    UploadToken lastToken() const;
+
+    //Wait for all submissions up to given index to finish and free their staging space
+    void retire(uint64_t submission);
+
     //this function is called when there are no more buffers to create, it allocates memory for all created buffers
     void createBuffersInternal(VkBufferUsageFlags, vector<Buffer>& buffers){
         DeviceLocalBufferMemoryObject mem(buffers);
@@ -156,7 +319,7 @@ private:
         //create remaining buffers
         createBuffersInternal(default_usage_flags, buffers, other_data_vectors...);
         //after all buffers are created, they have memory bound to them already. Now given data can be copied to the buffer
-        copyToLocal(data.data, buffers[buffer_i]);
+        copyToLocalAsync(data.data.data(), data.data.size(), buffers[buffer_i]);
     }
 };
 
@@ -0,0 +1,153 @@
+#include "local_object_reader.h"
+
+#include "buffer_info.h"
+#include "image.h"
+#include <algorithm>
+
+
+ReadbackToken::ReadbackToken(uint64_t readback_) : readback(readback_)
+{}
+
+
+
+ReadbackSubmission::ReadbackSubmission(uint32_t queue_family_index) : pool(queue_family_index), command_buffer(VK_NULL_HANDLE), fence(), staging_offset(0), size(0), staging_size(0), index(0), callback(nullptr)
+{}
+
+
+
+LocalObjectReader::LocalObjectReader(Queue& queue, VkDeviceSize staging_buffer_size) : m_staging_buffer_size(staging_buffer_size),
+    m_staging_buffer(BufferInfo(staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT).create()), m_staging_buffer_memory({m_staging_buffer}),
+    m_staging_head(0), m_staging_used(0), m_next_readback(1), m_completed_readback(0), m_queue(queue)
+{
+    //create one transient command pool and fence for each readback in flight
+    m_submissions.reserve(READBACKS_IN_FLIGHT);
+    for (uint32_t i = 0; i < READBACKS_IN_FLIGHT; i++){
+        m_submissions.push_back(ReadbackSubmission(queue.getFamilyIndex()));
+    }
+}
+ReadbackToken LocalObjectReader::copyFromLocalAsync(Buffer& buffer, VkDeviceSize size, VkDeviceSize offset, ReadbackCallback callback){
+    //read the rest of the buffer if size isn't given
+    if (size == VK_WHOLE_SIZE) size = buffer.getSize() - offset;
+    ReadbackSubmission& readback = startReadback(size, 4, callback);
+    //wait for all previous writes to the buffer, then copy it to staging buffer
+    readback.command_buffer.cmdBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, buffer.createMemoryBarrier(VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+    readback.command_buffer.cmdCopyFromBuffer(buffer, m_staging_buffer, size, offset, readback.staging_offset);
+    return submit(readback);
+}
+ReadbackToken LocalObjectReader::copyFromLocalAsync(Image& image, ImageState state, ImageState end_state, ReadbackCallback callback){
+    //buffer offset of image copy must be a multiple of both 4 and texel size
+    ReadbackSubmission& readback = startReadback(image.getSizeInBytes(), 4 * image.getFormat().getSize(), callback);
+    readback.command_buffer.cmdCopyFromTexture(image, state, end_state, m_staging_buffer, readback.staging_offset);
+    return submit(readback);
+}
+vector<uint8_t> LocalObjectReader::copyFromLocal(Image& image, ImageState state, ImageState end_state){
+    return read(copyFromLocalAsync(image, state, end_state));
+}
+bool LocalObjectReader::isComplete(ReadbackToken token){
+    //go through readbacks in flight in order, retire all that have finished already
+    while (m_completed_readback < token.readback){
+        if (!m_submissions[(m_completed_readback + 1) % READBACKS_IN_FLIGHT].fence.waitFor(0)) return false;
+        retire(m_completed_readback + 1);
+    }
+    return true;
+}
+void LocalObjectReader::poll(){
+    isComplete(ReadbackToken(m_next_readback - 1));
+}
+vector<uint8_t> LocalObjectReader::read(ReadbackToken token){
+    if (token.readback == 0 || token.readback >= m_next_readback){
+        PRINT_ERROR("Reading readback with invalid token: " << token.readback)
+        return vector<uint8_t>();
+    }
+    retire(token.readback);
+    //find the data, it isn't there if the readback used a callback or the data was read already
+    auto result = m_results.find(token.readback);
+    if (result == m_results.end()){
+        PRINT_ERROR("Readback data isn't available, it was read already or passed to a callback. Token: " << token.readback)
+        return vector<uint8_t>();
+    }
+    vector<uint8_t> data = std::move(result->second);
+    m_results.erase(result);
+    return data;
+}
+void LocalObjectReader::waitFor(ReadbackToken token){
+    retire(std::min(token.readback, m_next_readback - 1));
+}
+void LocalObjectReader::waitAll(){
+    retire(m_next_readback - 1);
+}
+VkDeviceSize LocalObjectReader::reserveStaging(VkDeviceSize size, VkDeviceSize alignment){
+    //if the data can never fit, print error and fail
+    if (size > m_staging_buffer_size){
+        PRINT_ERROR("Trying to read data of larger size than staging buffer. Staging buffer size: " << m_staging_buffer_size << ", data size: " << size)
+        throw std::runtime_error("Staging buffer too small");
+    }
+    while (true){
+        //if nothing is using the ring, start from the beginning again
+        if (m_staging_used == 0) m_staging_head = 0;
+        //align the offset, if the data doesn't fit before the end of the ring, wrap around and waste the remaining space
+        VkDeviceSize offset = roundUpToMemoryBlock(m_staging_head, alignment);
+        VkDeviceSize padding = offset - m_staging_head;
+        if (offset + size > m_staging_buffer_size){
+            offset = 0;
+            padding = m_staging_buffer_size - m_staging_head;
+        }
+        VkDeviceSize used = padding + size;
+        //if there is enough space, reserve it for the readback being created
+        if (m_staging_used + used <= m_staging_buffer_size){
+            m_submissions[m_next_readback % READBACKS_IN_FLIGHT].staging_size = used;
+            m_staging_used += used;
+            m_staging_head = offset + size;
+            return offset;
+        }
+        //not enough space - wait for the oldest readback
+        retire(m_completed_readback + 1);
+    }
+}
+ReadbackSubmission& LocalObjectReader::startReadback(VkDeviceSize size, VkDeviceSize alignment, ReadbackCallback callback){
+    ReadbackSubmission& readback = m_submissions[m_next_readback % READBACKS_IN_FLIGHT];
+    //if the command buffer is still in flight from an older readback, wait for it
+    if (readback.index != 0) retire(readback.index);
+    readback.staging_offset = reserveStaging(size, alignment);
+    readback.size = size;
+    readback.callback = callback;
+    //the previous command buffer finished, reset the whole pool instead of the buffer
+    readback.pool.reset();
+    readback.command_buffer = readback.pool.allocateBuffer();
+    readback.command_buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    return readback;
+}
+ReadbackToken LocalObjectReader::submit(ReadbackSubmission& readback){
+    //make transfer writes to the staging buffer visible to the host
+    readback.command_buffer.cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, m_staging_buffer.createMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT));
+    readback.command_buffer.endRecord();
+    //submit the command buffer with the readback fence
+    SubmitSynchronization readback_synchronization;
+    readback_synchronization.setEndFence(readback.fence);
+    m_queue.submit(readback.command_buffer, readback_synchronization);
+    readback.index = m_next_readback++;
+    return ReadbackToken(readback.index);
+}
+void LocalObjectReader::retire(uint64_t readback){
+    //readbacks are retired in order, wait for each one up to the given index
+    while (m_completed_readback < readback){
+        ReadbackSubmission& oldest = m_submissions[(m_completed_readback + 1) % READBACKS_IN_FLIGHT];
+        //wait a while for the copy to finish, print error if it took too long
+        if (!oldest.fence.waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for readback expired")
+        oldest.fence.reset();
+        //make the data visible on the host, then pass it to the callback or save it
+        m_staging_buffer_memory.invalidate(0, oldest.staging_offset, oldest.size);
+        const uint8_t* data = m_staging_buffer_memory.getData(0) + oldest.staging_offset;
+        if (oldest.callback){
+            oldest.callback(data, oldest.size);
+            oldest.callback = nullptr;
+        }else{
+            m_results[oldest.index] = vector<uint8_t>(data, data + oldest.size);
+        }
+        //free the staging space used by the readback
+        m_staging_used -= oldest.staging_size;
+        oldest.staging_size = 0;
+        oldest.index = 0;
+        m_completed_readback++;
+    }
+}
@@ -0,0 +1,170 @@
+#ifndef LOCAL_OBJECT_READER_H
+#define LOCAL_OBJECT_READER_H
+
+/**
+ * local_object_reader.h
+ *  - Holds LocalObjectReader, the counterpart of LocalObjectCreator, used for copying data from the GPU back to the CPU
+ */
+
+
+#include "../01_device/device.h"
+#include "../03_commands/command_buffer.h"
+#include "../03_commands/command_pool.h"
+#include "../03_commands/synchronization.h"
+#include "buffer.h"
+#include <functional>
+#include <map>
+
+using std::function;
+using std::map;
+
+
+//how many readbacks can be executed on the GPU at once
+const uint32_t READBACKS_IN_FLIGHT = 4;
+
+//function called with the data of a finished readback. The data pointer is valid only during the call
+using ReadbackCallback = function<void(const uint8_t* data, VkDeviceSize size)>;
+
+
+/**
+ * ReadbackToken
+ *  - Identifies a submitted readback, is used to check whether it has finished and to get its' data
+ */
+class ReadbackToken{
+public:
+    //index of the readback, 0 is invalid
+    uint64_t readback;
+    ReadbackToken(uint64_t readback_ = 0);
+};
+
+
+/**
+ * ReadbackSubmission
+ *  - One command buffer and fence used by the LocalObjectReader for one readback
+ */
+class ReadbackSubmission{
+public:
+    //transient pool of the readback, reset as a whole before each reuse
+    TransientCommandPool pool;
+    CommandBuffer command_buffer;
+    //signaled when the copy finishes
+    Fence fence;
+    //where the data is placed in the staging buffer
+    VkDeviceSize staging_offset;
+    //size of the data in bytes
+    VkDeviceSize size;
+    //number of staging buffer bytes used by this readback, including padding when the staging ring wraps around
+    VkDeviceSize staging_size;
+    //index of the readback, 0 if it isn't in flight
+    uint64_t index;
+    //function to call when the data is ready, if empty, the data is kept until LocalObjectReader::read is called
+    ReadbackCallback callback;
+    ReadbackSubmission(uint32_t queue_family_index);
+};
+
+
+/**
+ * LocalObjectReader
+ *  - class responsible for copying data from buffers and images on the GPU back to the CPU
+ *  - the staging buffer is placed in host cached memory if possible and used as a ring, up to READBACKS_IN_FLIGHT readbacks can be executed at once
+ *  - finished readbacks either call their callback, or keep their data until it is read using the token
+ */
+class LocalObjectReader{
+    //size of staging buffer in bytes
+    VkDeviceSize m_staging_buffer_size;
+    //buffer in the shared memory - data is copied into it on the GPU, and read from it on the CPU
+    Buffer m_staging_buffer;
+    //memory object for the staging buffer
+    ReadbackBufferMemoryObject m_staging_buffer_memory;
+    //offset in the staging buffer where the next data will be placed
+    VkDeviceSize m_staging_head;
+    //number of staging buffer bytes used by readbacks that weren't delivered yet
+    VkDeviceSize m_staging_used;
+    //command buffers and fences, used in a circle
+    vector<ReadbackSubmission> m_submissions;
+    //index of the next readback. Indices start at 1
+    uint64_t m_next_readback;
+    //all readbacks with index lower or equal to this one have finished
+    uint64_t m_completed_readback;
+    //data of finished readbacks without a callback, waiting to be read
+    map<uint64_t, vector<uint8_t>> m_results;
+    //the queue to record copies on
+    Queue& m_queue;
+public:
+    /**
+     * Create a new LocalObjectReader.
+     * @param queue the queue to use for copying the data, should be the same one that writes the resources to avoid ownership transfers
+     * @param staging_buffer_size size of staging buffer in bytes, one readback cannot be larger than this
+     */
+    LocalObjectReader(Queue& queue, VkDeviceSize staging_buffer_size = 1024u * 1024u);
+
+    /**
+     * Start copying buffer data to the CPU, return a token that can be used to get the data once the copy finishes.
+     * All writes to the buffer submitted to the queue before this call are finished before copying.
+     * @param buffer the buffer to read
+     * @param size number of bytes to read, the rest of the buffer by default
+     * @param offset offset in bytes in the buffer
+     * @param callback if given, it is called with the data when the copy finishes, and read() cannot be used with the token
+     */
+    ReadbackToken copyFromLocalAsync(Buffer& buffer, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0, ReadbackCallback callback = nullptr);
+
+    /**
+     * Start copying the whole image to the CPU, tightly packed. Return a token that can be used to get the data once the copy finishes.
+     * @param image the image to read
+     * @param state the state the image is now in
+     * @param end_state the state the image should be in after copying
+     * @param callback if given, it is called with the data when the copy finishes, and read() cannot be used with the token
+     */
+    ReadbackToken copyFromLocalAsync(Image& image, ImageState state, ImageState end_state, ReadbackCallback callback = nullptr);
+
+    /**
+     * Copy buffer data to the CPU, wait until the copy finishes
+     * @param buffer the buffer to read
+     * @param offset offset in bytes in the buffer
+     */
+    template<typename T>
+    vector<T> copyFromLocal(Buffer& buffer, VkDeviceSize offset = 0){
+        vector<uint8_t> data = read(copyFromLocalAsync(buffer, VK_WHOLE_SIZE, offset));
+        //reinterpret the bytes as an array of T
+        vector<T> result(data.size() / sizeof(T));
+        memcpy(result.data(), data.data(), result.size() * sizeof(T));
+        return result;
+    }
+
+    //Copy the whole image to the CPU, wait until the copy finishes
+    vector<uint8_t> copyFromLocal(Image& image, ImageState state, ImageState end_state);
+
+    //Return true if the readback with given token has finished. Doesn't block
+    bool isComplete(ReadbackToken token);
+
+    //Deliver data of all finished readbacks - call their callbacks, or save the data for read(). Doesn't block
+    void poll();
+
+    //Wait until the readback with given token finishes and return its' data
+    vector<uint8_t> read(ReadbackToken token);
+
+    //Wait until the readback with given token finishes, deliver its' data. Unlike read(), can be used for readbacks with a callback
+    void waitFor(ReadbackToken token);
+
+    //Wait until all readbacks finish
+    void waitAll();
+private:
+    /**
+     * Find space in the staging ring, waiting for older readbacks to finish if there isn't enough. Return offset of the reserved space.
+     * @param size number of bytes to reserve
+     * @param alignment the returned offset will be a multiple of this value
+     */
+    VkDeviceSize reserveStaging(VkDeviceSize size, VkDeviceSize alignment);
+
+    //Reserve staging space and a command buffer for a new readback, start recording it
+    ReadbackSubmission& startReadback(VkDeviceSize size, VkDeviceSize alignment, ReadbackCallback callback);
+
+    //Make the copied data visible to the host, end the command buffer and submit it
+    ReadbackToken submit(ReadbackSubmission& submission);
+
+    //Wait for all readbacks up to given index to finish, deliver their data and free their staging space
+    void retire(uint64_t readback);
+};
+
+
+#endif
@@ -126,8 +126,10 @@ public:
  *  - this class holds the actual data for the uniform buffer
  */
 class UniformBufferData : public vector<uint8_t>{
+    //incremented by every write that changes the data
+    uint64_t m_version;
 public:
-    UniformBufferData(uint32_t buffer_size = 0) : vector<uint8_t>(buffer_size, 0)
+    UniformBufferData(uint32_t buffer_size = 0) : vector<uint8_t>(buffer_size, 0), m_version(0)
     {}
 
     template<typename T>
@@ -136,10 +138,19 @@ public:
         return *this;
     }
     void writeBytes(uint32_t data_offset_bytes, const void* val, uint32_t data_len_bytes){
-        if (data_offset_bytes + data_len_bytes >= size()){
+        //writing the same values again doesn't count as a change, so data rewritten every frame can stay in recorded command buffers
+        if (data_offset_bytes + data_len_bytes <= size() && memcmp(data() + data_offset_bytes, val, data_len_bytes) == 0){
+            return;
+        }
+        if (data_offset_bytes + data_len_bytes > size()){
             resize(data_offset_bytes + data_len_bytes);
         }
         memcpy(data() + data_offset_bytes, val, data_len_bytes);
+        m_version++;
+    }
+    //Get a number that changes whenever the data changes
+    uint64_t getVersion() const{
+        return m_version;
     }
 };
 
@@ -0,0 +1,64 @@
+#include "uniform_ring_buffer.h"
+
+#include "buffer_info.h"
+#include "../01_device/allocator.h"
+
+
+UniformRingAllocation::UniformRingAllocation(uint8_t* data_, VkDeviceSize offset_, VkDeviceSize size_) : data(data_), offset(offset_), size(size_)
+{}
+uint32_t UniformRingAllocation::dynamicOffset() const{
+    return (uint32_t) offset;
+}
+
+
+
+UniformRingBuffer::UniformRingBuffer(VkDeviceSize frame_size, uint32_t frame_count, VkBufferUsageFlags usage, const MemoryTypeRequest& memory_request) :
+    m_frame_count(frame_count), m_alignment(computeAlignment(usage)),
+    //flushed ranges are rounded to nonCoherentAtomSize, regions start on a multiple of it as well
+    m_frame_size(roundUpToMemoryBlock(frame_size, std::max(m_alignment, g_allocator.get().getLimits().nonCoherentAtomSize))),
+    m_buffer(BufferInfo(m_frame_size * frame_count, usage).create()), m_memory({m_buffer}, memory_request),
+    m_frame(0), m_head(0), m_flushed(0)
+{}
+void UniformRingBuffer::beginFrame(){
+    //make sure nothing written in the last frame stays unflushed
+    flush();
+    //move to the next region
+    m_frame = (m_frame + 1) % m_frame_count;
+    m_head = 0;
+    m_flushed = 0;
+}
+UniformRingAllocation UniformRingBuffer::allocate(VkDeviceSize size){
+    //if the frame region is full, print error and fail
+    if (m_head + size > m_frame_size){
+        PRINT_ERROR("Uniform ring buffer frame region is full. Region size: " << m_frame_size << ", used: " << m_head << ", requested: " << size)
+        throw std::runtime_error("Uniform ring buffer full");
+    }
+    VkDeviceSize offset = m_frame * m_frame_size + m_head;
+    //next allocation starts on the next aligned offset
+    m_head = std::min(roundUpToMemoryBlock(m_head + size, m_alignment), m_frame_size);
+    return UniformRingAllocation(m_memory.getData(0) + offset, offset, size);
+}
+UniformRingAllocation UniformRingBuffer::write(const UniformBufferData& data){
+    UniformRingAllocation allocation = allocate(data.size());
+    memcpy(allocation.data, data.data(), data.size());
+    return allocation;
+}
+void UniformRingBuffer::flush(){
+    //flush only the part of the region written since the last flush, with one call. Does nothing on coherent memory
+    if (m_head > m_flushed){
+        m_memory.flush(0, m_frame * m_frame_size + m_flushed, m_head - m_flushed);
+    }
+    m_flushed = m_head;
+}
+const Buffer& UniformRingBuffer::getBuffer() const{
+    return m_buffer;
+}
+VkDeviceSize UniformRingBuffer::getAlignment() const{
+    return m_alignment;
+}
+VkDeviceSize UniformRingBuffer::computeAlignment(VkBufferUsageFlags usage){
+    const VkPhysicalDeviceLimits& limits = g_allocator.get().getLimits();
+    VkDeviceSize alignment = limits.minUniformBufferOffsetAlignment;
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+    return alignment;
+}
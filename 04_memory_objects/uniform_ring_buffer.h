@@ -0,0 +1,90 @@
+#ifndef UNIFORM_RING_BUFFER_H
+#define UNIFORM_RING_BUFFER_H
+
+/**
+ * uniform_ring_buffer.h
+ *  - Holds a persistently mapped buffer used for uniform data that changes every frame
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "buffer.h"
+#include "mixed_buffer.h"
+
+
+/**
+ * UniformRingAllocation
+ *  - One part of the UniformRingBuffer, valid until the same frame slot is used again
+ */
+class UniformRingAllocation{
+public:
+    //pointer to mapped memory of the allocation
+    uint8_t* data;
+    //offset from the start of the ring buffer, can be used as dynamic offset or as descriptor offset
+    VkDeviceSize offset;
+    //size of the allocation in bytes
+    VkDeviceSize size;
+    UniformRingAllocation(uint8_t* data_, VkDeviceSize offset_, VkDeviceSize size_);
+
+    //return offset, to be passed to CommandBuffer::cmdBindSets as a dynamic offset
+    uint32_t dynamicOffset() const;
+};
+
+
+/**
+ * UniformRingBuffer
+ *  - One buffer split into a region for each frame in flight. Every frame, sub-allocations are taken linearly from the region of that frame.
+ *  - Memory is mapped once, writes are flushed together once per frame (flushing is skipped for coherent memory)
+ *  - Allocations are aligned to minUniformBufferOffsetAlignment, so they can be used as dynamic uniform buffer offsets
+ *  - A frame region is reused frame_count frames later, the GPU must have finished the frame that used it before beginFrame() is called
+ */
+class UniformRingBuffer{
+    //number of frame regions in the buffer
+    uint32_t m_frame_count;
+    //offset of every allocation is a multiple of this value
+    VkDeviceSize m_alignment;
+    //size of one frame region in bytes, multiple of alignment
+    VkDeviceSize m_frame_size;
+    Buffer m_buffer;
+    SharedBufferMemoryObject m_memory;
+    //region used in the current frame
+    uint32_t m_frame;
+    //offset of the next allocation from the start of current frame region
+    VkDeviceSize m_head;
+    //part of current region that was already flushed
+    VkDeviceSize m_flushed;
+public:
+    /**
+     * Create a ring buffer.
+     * @param frame_size maximum number of bytes allocated during one frame
+     * @param frame_count number of frames that can be in flight at once
+     * @param usage buffer usage, if VK_BUFFER_USAGE_STORAGE_BUFFER_BIT is included, storage buffer alignment is respected as well
+     * @param memory_request memory the buffer is placed in, required properties must contain VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT. Host visible device local memory is used by default if available
+     */
+    UniformRingBuffer(VkDeviceSize frame_size, uint32_t frame_count = 2, VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        const MemoryTypeRequest& memory_request = MemoryTypeRequest(MEMORY_USAGE_FREQUENT_UPDATE));
+
+    //Move to the region of the next frame and start allocating from its' beginning. Flushes the previous frame if flush() wasn't called
+    void beginFrame();
+
+    //Reserve given number of bytes in the current frame region. Data written into it is made visible to the GPU by flush()
+    UniformRingAllocation allocate(VkDeviceSize size);
+
+    //Reserve space for given data and copy the data into it
+    UniformRingAllocation write(const UniformBufferData& data);
+
+    //Flush everything written in the current frame since the last flush. Call once per frame, before submitting commands that read the data
+    void flush();
+
+    //Get the buffer, descriptors should point to it with range of the largest allocation
+    const Buffer& getBuffer() const;
+
+    //Get alignment of allocations
+    VkDeviceSize getAlignment() const;
+private:
+    //compute alignment of allocations for given usage
+    static VkDeviceSize computeAlignment(VkBufferUsageFlags usage);
+};
+
+
+#endif
@@ -9,7 +9,7 @@ void DescriptorPool::reset(){
     vkResetDescriptorPool(g_device, m_descriptor_pool, 0);
 }
 void DescriptorPool::destroy(){
-    vkDestroyDescriptorPool(g_device, m_descriptor_pool, nullptr);
+    g_allocator.get().destroyDescriptorPool(m_descriptor_pool);
 }
 VkDescriptorSet DescriptorPool::allocateSet(const VkDescriptorSetLayout& descriptor_set_layout){
     //fill descriptor set allocate info structure
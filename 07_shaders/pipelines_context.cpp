@@ -190,7 +190,7 @@ VkShaderStageFlags PushConstantData::getStages() const {
     return m_stages;
 }
 uint32_t PushConstantData::size() const{
-    return roundUpToMemoryBlock(UniformBufferLayoutData::size(), 4ULL);
+    return roundUpToMemoryBlock<size_t>(UniformBufferLayoutData::size(), 4);
 }
 
 
@@ -3,11 +3,33 @@
 
 
 
-FlowSection::FlowSection(const vector<FlowSectionDescriptorUsage>& usages) : m_descriptors_used(usages)
+FlowSection::FlowSection(const vector<FlowSectionDescriptorUsage>& usages) : m_descriptors_used(usages), m_version(0)
 {}
 void FlowSection::complete(){}
 
+//all access flags that write memory
+const VkAccessFlags FLOW_WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+bool isWriteAccess(VkAccessFlags access){
+    return (access & FLOW_WRITE_ACCESS) != 0;
+}
+bool isReadAccess(VkAccessFlags access){
+    return (access & ~FLOW_WRITE_ACCESS) != 0;
+}
+
+//return true if a read with given stages and access is already covered by the previous read - nothing was written since and the memory is visible to them
+bool isRedundantRead(VkPipelineStageFlags last_use, VkAccessFlags last_access, VkPipelineStageFlags usage_stages, VkAccessFlags access){
+    if (isWriteAccess(last_access) || isWriteAccess(access) || last_access == 0) return false;
+    return (usage_stages & ~last_use) == 0 && (access & ~last_access) == 0;
+}
+
 void FlowSection::transition(CommandBuffer& buffer, FlowDescriptorContext& flow_context){
+    BarrierBatch batch;
+    transition(batch, flow_context);
+    batch.record(buffer);
+}
+void FlowSection::transition(BarrierBatch& batch, FlowDescriptorContext& flow_context){
     //go through all descriptors
     for (const FlowSectionDescriptorUsage& d : m_descriptors_used){
         int i = d.descriptor_index;
@@ -15,22 +37,45 @@ void FlowSection::transition(CommandBuffer& buffer, FlowDescriptorContext& flow_
         if (d.isImage()){
             //get the state the image was previously in
             PipelineImageState& state = flow_context.getImageState(i);
-            //create image memory barrier on command buffer, specify: last stages during which the image was used, stages during which the image will be used, image memory barrier
+            //no barrier is needed for a read in the same layout that is already visible
+            if (state.layout == d.state.image.layout && isRedundantRead(state.last_use, state.access, d.usage_stages, d.state.image.access)) continue;
+            //add image memory barrier to the batch, specify: last stages during which the image was used, stages during which the image will be used, image memory barrier
             //                                                                         state image was in before, new_state
-            buffer.cmdBarrier(state.last_use, d.usage_stages, flow_context.getImage(i).createMemoryBarrier(state, d.state.image));
+            batch.add(state.last_use, d.usage_stages, flow_context.getImage(i).createMemoryBarrier(state, d.state.image));
             //update current image state to the one after barrier
             state = d.toImageState();
         //descriptor is a buffer
         }else{
             //get previous state of buffer
             PipelineBufferState& state = flow_context.getBufferState(i);
-            //create buffer memory barrier on command buffer, specify last stages when the buffer was used, and the ones it will be used in. Then create buffer memory barrier from previous access and required access
-            buffer.cmdBarrier(state.last_use, d.usage_stages, flow_context.getBuffer(i).createMemoryBarrier(state.access, d.state.buffer.access));
+            if (isRedundantRead(state.last_use, state.access, d.usage_stages, d.state.buffer.access)) continue;
+            //add buffer memory barrier to the batch, specify last stages when the buffer was used, and the ones it will be used in. Then create buffer memory barrier from previous access and required access
+            batch.add(state.last_use, d.usage_stages, flow_context.getBuffer(i).createMemoryBarrier(state.access, d.state.buffer.access));
             //update current buffer state
             state = d.toBufferState();
         }
     }
 }
+bool FlowSection::sharesDescriptors(const FlowSection& other) const{
+    for (const FlowSectionDescriptorUsage& a : m_descriptors_used){
+        for (const FlowSectionDescriptorUsage& b : other.m_descriptors_used){
+            if (a.isImage() == b.isImage() && a.descriptor_index == b.descriptor_index) return true;
+        }
+    }
+    return false;
+}
+const vector<FlowSectionDescriptorUsage>& FlowSection::getDescriptorUsages() const{
+    return m_descriptors_used;
+}
+bool FlowSection::transitionsDuringExecute() const{
+    return false;
+}
+void FlowSection::invalidate(){
+    m_version++;
+}
+uint64_t FlowSection::getRecordVersion() const{
+    return m_version;
+}
 void FlowSection::run(CommandBuffer& command_buffer, FlowDescriptorContext& flow_context){
     transition(command_buffer, flow_context);
     execute(command_buffer);
@@ -114,6 +159,8 @@ void FlowSimplePipelineSection::complete(){
     //allocate descriptor set and update all its' descriptors using update infos
     m_context.allocateDescriptorSets(m_descriptor_set);
     m_descriptor_set.updateDescriptorsV(m_descriptor_update_infos);
+    //buffers recorded with the previous descriptor set can't be used anymore
+    invalidate();
 }
 void FlowSimplePipelineSection::bind(CommandBuffer& buffer){
     //bind pipeline with descriptor set
@@ -155,10 +202,187 @@ void FlowSectionList::complete(){
     }
 }
 void FlowSectionList::execute(CommandBuffer& buffer){
+    vector<FlowSection*> sections;
+    sections.reserve(m_sections.size());
     for (unique_ptr<FlowSection>& s : m_sections){
-        s->run(buffer, m_context);
+        sections.push_back(s.get());
     }
+    runSectionsBatched(sections, buffer, m_context);
+}
+bool FlowSectionList::transitionsDuringExecute() const{
+    return true;
+}
+uint64_t FlowSectionList::getRecordVersion() const{
+    uint64_t version = FlowSection::getRecordVersion();
+    for (const unique_ptr<FlowSection>& s : m_sections){
+        version += s->getRecordVersion();
+    }
+    return version;
 }
 
 void FlowSectionList::addSections(){}
 
+
+
+
+FlowParallelSectionList& FlowParallelSectionList::setRenderPass(RenderPassSettings& settings, VkRenderPass render_pass){
+    m_render_pass_settings = &settings;
+    m_render_pass = render_pass;
+    return *this;
+}
+FlowParallelSectionList& FlowParallelSectionList::setFramebuffer(VkFramebuffer framebuffer){
+    if (m_framebuffer != framebuffer) invalidate();
+    m_framebuffer = framebuffer;
+    return *this;
+}
+void FlowParallelSectionList::complete(){
+    //such sections would record barriers into the secondary buffers, possibly inside the render pass
+    for (unique_ptr<FlowSection>& s : m_sections){
+        if (s->transitionsDuringExecute()){
+            PRINT_ERROR("Sections that transition during execution can't be recorded in parallel")
+            throw std::runtime_error("Sections that transition during execution can't be recorded in parallel");
+        }
+    }
+    for (unique_ptr<FlowSection>& s : m_sections){
+        s->complete();
+    }
+}
+void FlowParallelSectionList::execute(CommandBuffer& buffer){
+    //barriers can't be recorded in secondary buffers inside a render pass, do all of them on the primary buffer beforehand
+    BarrierBatch batch;
+    for (unique_ptr<FlowSection>& s : m_sections){
+        s->transition(batch, m_context);
+    }
+    batch.record(buffer);
+    CommandBufferInheritanceInfo inheritance;
+    if (m_render_pass != VK_NULL_HANDLE){
+        inheritance.setRenderPass(m_render_pass, 0).setFramebuffer(m_framebuffer);
+        buffer.cmdBeginRenderPass(*m_render_pass_settings, m_render_pass, m_framebuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    }
+    //one job for each section, they only read section data, so they can run at the same time
+    vector<RecordJob> jobs;
+    jobs.reserve(m_sections.size());
+    for (unique_ptr<FlowSection>& s : m_sections){
+        FlowSection* section = s.get();
+        jobs.push_back([section](CommandBuffer& secondary){section->execute(secondary);});
+    }
+    m_recorder.record(buffer, inheritance, jobs);
+    if (m_render_pass != VK_NULL_HANDLE){
+        buffer.cmdEndRenderPass();
+    }
+}
+
+bool FlowParallelSectionList::transitionsDuringExecute() const{
+    return true;
+}
+uint64_t FlowParallelSectionList::getRecordVersion() const{
+    uint64_t version = FlowSection::getRecordVersion();
+    for (const unique_ptr<FlowSection>& s : m_sections){
+        version += s->getRecordVersion();
+    }
+    return version;
+}
+
+void FlowParallelSectionList::addSections(){}
+
+
+
+
+FlowBakedRecording::FlowBakedRecording(const CommandBuffer& buffer_) : buffer(buffer_), recorded(false), version(0)
+{}
+
+
+
+FlowBakedSection::FlowBakedSection(FlowDescriptorContext& ctx, FlowSection* section, uint32_t queue_family_index, uint32_t frames_in_flight) :
+    FlowSection({}), m_context(ctx), m_section(section), m_pool(CommandPoolInfo(queue_family_index, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT).create()),
+    m_current(0), m_record_count(0)
+{
+    for (const CommandBuffer& buffer : m_pool.allocateBuffers(frames_in_flight, VK_COMMAND_BUFFER_LEVEL_SECONDARY)){
+        m_recordings.push_back(FlowBakedRecording(buffer));
+    }
+}
+void FlowBakedSection::complete(){
+    m_section->complete();
+}
+void FlowBakedSection::execute(CommandBuffer& buffer){
+    m_current = (m_current + 1) % m_recordings.size();
+    FlowBakedRecording& recording = m_recordings[m_current];
+    if (!recording.recorded || recording.version != m_section->getRecordVersion() || !statesMatch(recording)){
+        record(recording);
+    }else{
+        //descriptors end in the same states as when the buffer was recorded
+        for (uint32_t i = 0; i < recording.end_image_states.size(); i++) m_context.getImageState(i) = recording.end_image_states[i];
+        for (uint32_t i = 0; i < recording.end_buffer_states.size(); i++) m_context.getBufferState(i) = recording.end_buffer_states[i];
+    }
+    buffer.cmdExecuteCommands(recording.buffer);
+}
+bool FlowBakedSection::transitionsDuringExecute() const{
+    return true;
+}
+uint64_t FlowBakedSection::getRecordVersion() const{
+    return FlowSection::getRecordVersion() + m_section->getRecordVersion();
+}
+uint32_t FlowBakedSection::getRecordCount() const{
+    return m_record_count;
+}
+void FlowBakedSection::destroy(){
+    m_pool.destroy();
+    m_recordings.clear();
+}
+bool FlowBakedSection::statesMatch(const FlowBakedRecording& recording) const{
+    if (recording.start_image_states.size() != m_context.getImageCount() || recording.start_buffer_states.size() != m_context.getBufferCount()) return false;
+    for (uint32_t i = 0; i < recording.start_image_states.size(); i++){
+        const PipelineImageState& a = recording.start_image_states[i], &b = m_context.getImageState(i);
+        if (a.layout != b.layout || a.access != b.access || a.last_use != b.last_use) return false;
+    }
+    for (uint32_t i = 0; i < recording.start_buffer_states.size(); i++){
+        const PipelineBufferState& a = recording.start_buffer_states[i], &b = m_context.getBufferState(i);
+        if (a.access != b.access || a.last_use != b.last_use) return false;
+    }
+    return true;
+}
+void FlowBakedSection::record(FlowBakedRecording& recording){
+    recording.start_image_states.clear();
+    recording.start_buffer_states.clear();
+    for (uint32_t i = 0; i < m_context.getImageCount(); i++) recording.start_image_states.push_back(m_context.getImageState(i));
+    for (uint32_t i = 0; i < m_context.getBufferCount(); i++) recording.start_buffer_states.push_back(m_context.getBufferState(i));
+    //beginning the recording resets the buffer, the frame that used it last has finished
+    recording.buffer.startRecordSecondary(CommandBufferInheritanceInfo());
+    m_section->run(recording.buffer, m_context);
+    recording.buffer.endRecord();
+    //loop sections write push constants while recording, the version is taken afterwards
+    recording.version = m_section->getRecordVersion();
+    recording.recorded = true;
+    recording.end_image_states.clear();
+    recording.end_buffer_states.clear();
+    for (uint32_t i = 0; i < m_context.getImageCount(); i++) recording.end_image_states.push_back(m_context.getImageState(i));
+    for (uint32_t i = 0; i < m_context.getBufferCount(); i++) recording.end_buffer_states.push_back(m_context.getBufferState(i));
+    m_record_count++;
+}
+
+
+
+void runSectionsBatched(const vector<FlowSection*>& sections, CommandBuffer& buffer, FlowDescriptorContext& flow_context, const FlowSectionConflict& conflicts){
+    BarrierBatch batch;
+    //index of the first section that wasn't transitioned yet
+    size_t next = 0;
+    for (size_t i = 0; i < sections.size(); i++){
+        if (next <= i){
+            sections[i]->transition(batch, flow_context);
+            next = i + 1;
+            //move transitions of following sections before section i, if none of the sections in between use their descriptors. The barriers then come
+            //after the last use of the descriptors anyway, and all of them are recorded together
+            while (next < sections.size() && !sections[next - 1]->transitionsDuringExecute() && !sections[next]->transitionsDuringExecute()){
+                bool shared = false;
+                for (size_t j = i; j < next && !shared; j++){
+                    shared = sections[j]->sharesDescriptors(*sections[next]) || (conflicts && conflicts(*sections[j], *sections[next]));
+                }
+                if (shared) break;
+                sections[next]->transition(batch, flow_context);
+                next++;
+            }
+            batch.record(buffer);
+        }
+        sections[i]->execute(buffer);
+    }
+}
@@ -2,14 +2,27 @@
 #define FLOW_SECTIONS_H
 
 #include "flow_sections_base.h"
+#include "../03_commands/barrier_batch.h"
 #include "../03_commands/command_buffer.h"
+#include "../03_commands/command_pool.h"
+#include "../03_commands/parallel_recorder.h"
+#include "../03_commands/transient_command_allocator.h"
+#include "../06_render_passes/renderpass.h"
 #include "../08_pipeline/pipeline.h"
 
+#include <functional>
 #include <memory>
 
 using std::unique_ptr;
 using std::make_unique;
 
+//Return true if given access flags contain any write access
+bool isWriteAccess(VkAccessFlags access);
+
+//Return true if given access flags contain any read access
+bool isReadAccess(VkAccessFlags access);
+
+
 /**
  * FlowSection
  *  - Base class for all flow sections, holds a list of descriptors used by this section, has a method for transitioning all descriptors to correct states.
@@ -17,6 +30,8 @@ using std::make_unique;
 class FlowSection{
     //all descriptors used by this section
     vector<FlowSectionDescriptorUsage> m_descriptors_used;
+    //incremented when commands recorded by the section change
+    uint64_t m_version;
 public:
     /**
      * Construct flow section with given descriptor usages
@@ -30,12 +45,45 @@ public:
     virtual void complete();
     
     /**
-     * Transition all descriptors into the correct states to be used by this section. This is done by inserting multiple memory barriers.
+     * Transition all descriptors into the correct states to be used by this section. All barriers are recorded at once, using one barrier command.
      * @param buffer the buffer to record descriptor transitions into
      * @param flow_context descriptor context for this section
      */
     void transition(CommandBuffer& buffer, FlowDescriptorContext& flow_context);
 
+    /**
+     * Add barriers transitioning all descriptors into the correct states to given batch, and update the states in the descriptor context.
+     * Reads of a descriptor already made visible to the same stages and accesses in the same layout need no barrier and are skipped.
+     * Each descriptor should be used only once by a section, barriers in a batch can't depend on each other.
+     * @param batch the batch to add barriers to
+     * @param flow_context descriptor context for this section
+     */
+    void transition(BarrierBatch& batch, FlowDescriptorContext& flow_context);
+
+    /**
+     * Return true if this section and the other one use at least one common descriptor
+     * @param other the other section
+     */
+    bool sharesDescriptors(const FlowSection& other) const;
+
+    //Get usages of all descriptors used by this section
+    const vector<FlowSectionDescriptorUsage>& getDescriptorUsages() const;
+
+    /**
+     * Return true if the section records barriers for descriptors not listed in its' usages during execute(), e.g. section lists.
+     * Transitions of other sections can't be moved before such sections.
+     */
+    virtual bool transitionsDuringExecute() const;
+
+    //Mark commands recorded by this section as changed, e.g. after its' descriptors were updated. Baked sections containing it are recorded again
+    void invalidate();
+
+    /**
+     * Get a number that changes whenever commands recorded by execute() would change - push constants were written, descriptors updated or invalidate() was called.
+     * Sections containing other sections add versions of all of them
+     */
+    virtual uint64_t getRecordVersion() const;
+
     /**
      * Execute this section on the given command buffer. Section must be completed first, can be called multiple times.
      * @param command_buffer the buffer to record this section to
@@ -333,6 +381,11 @@ public:
         buffer.cmdPushConstants(this->m_pipeline, m_push_constant_data);
         T::execute(buffer);
     }
+
+    //Recorded commands change when push constants are written
+    virtual uint64_t getRecordVersion() const{
+        return T::getRecordVersion() + m_push_constant_data.getVersion();
+    }
 };
 
 
@@ -384,6 +437,11 @@ public:
             T::execute(buffer);
         }
     }
+
+    //Descriptors are transitioned between iterations, later transitions can't be moved before this section
+    virtual bool transitionsDuringExecute() const{
+        return true;
+    }
 };
 
 
@@ -418,11 +476,18 @@ public:
     virtual void complete();
 
     /**
-     * Run all subsections (call transition & execute on each one)
+     * Run all subsections (transition & execute each one). Transitions of following sections that don't use descriptors of the current one
+     * are recorded together with its' own, so that consecutive sections need as few barrier commands as possible
      * @param command_buffer the buffer to record subsections into
      */
     virtual void execute(CommandBuffer& command_buffer);
 
+    //Subsections transition their descriptors during execute(), returns true
+    virtual bool transitionsDuringExecute() const;
+
+    //Sum of record versions of all subsections
+    virtual uint64_t getRecordVersion() const;
+
     //Currently unused, might be helpful in the future
     /*void getLastImageStates(vector<PipelineImageState>& states) const{
         for (const unique_ptr<FlowSection>& section : *this){
@@ -445,4 +510,168 @@ private:
 };
 
 
+
+
+
+/**
+ * FlowParallelSectionList
+ *  - Holds sections whose execution is recorded in parallel, each one into its' own secondary command buffer. Useful for many FlowGraphicsSections drawing in one render pass
+ *  - Transitions of all sections are recorded into the primary buffer first, so sections must not depend on each other's results. Loop sections and section lists transition during execution and are rejected by complete()
+ *  - If a render pass is set, it is begun before the sections are executed and ended afterwards, all sections must draw in its' first subpass
+ */
+class FlowParallelSectionList : public FlowSection{
+    //descriptor context associated with this list
+    FlowDescriptorContext& m_context;
+    //recorder that runs section execution on worker threads
+    ParallelRecorder& m_recorder;
+    //render pass the sections draw in and its' settings, VK_NULL_HANDLE for sections outside of a render pass
+    RenderPassSettings* m_render_pass_settings;
+    VkRenderPass m_render_pass;
+    VkFramebuffer m_framebuffer;
+    //pointers to all sections
+    vector<unique_ptr<FlowSection>> m_sections;
+public:
+    /**
+     * Initialize FlowParallelSectionList with descriptor context, recorder and pointers to all subsections
+     * @param ctx flow descriptor context
+     * @param recorder the recorder to record subsections with
+     * @param args any number of pointers to sections (base class must be FlowSection)
+     */
+    template<typename... Args>
+    FlowParallelSectionList(FlowDescriptorContext& ctx, ParallelRecorder& recorder, Args*... args) :
+        FlowSection({}), m_context(ctx), m_recorder(recorder), m_render_pass_settings(nullptr), m_render_pass(VK_NULL_HANDLE), m_framebuffer(VK_NULL_HANDLE)
+    {
+        m_sections.reserve(sizeof...(args));
+        addSections(args...);
+    }
+
+    /**
+     * Draw all sections in given render pass. The framebuffer has to be set before each execution
+     * @param settings render area and clear values
+     * @param render_pass the render pass all sections were created for
+     */
+    FlowParallelSectionList& setRenderPass(RenderPassSettings& settings, VkRenderPass render_pass);
+
+    //Set framebuffer to draw into, e.g. the one of current swapchain image
+    FlowParallelSectionList& setFramebuffer(VkFramebuffer framebuffer);
+
+    /**
+     * Call complete() on all subsections. Throws if a subsection transitions during execution, e.g. a loop section or a section list
+     */
+    virtual void complete();
+
+    /**
+     * Transition descriptors of all subsections, then record their execution in parallel and execute it from given buffer
+     * @param command_buffer the primary buffer to record transitions into and execute subsections from
+     */
+    virtual void execute(CommandBuffer& command_buffer);
+
+    //Subsections transition their descriptors during execute(), returns true
+    virtual bool transitionsDuringExecute() const;
+
+    //Sum of record versions of all subsections
+    virtual uint64_t getRecordVersion() const;
+private:
+    //is called when there are no more sections left to add, does nothing
+    void addSections();
+    //Is called while there are sections still to add
+    template<typename T, typename... Args>
+    void addSections(T* ptr, Args*... args){
+        m_sections.emplace_back(unique_ptr<T>(ptr));
+        addSections(args...);
+    }
+};
+
+
+/**
+ * FlowBakedRecording
+ *  - One reusable recording of a baked section, with descriptor states it was recorded for and states it leaves descriptors in
+ */
+class FlowBakedRecording{
+public:
+    CommandBuffer buffer;
+    //false until the buffer is recorded for the first time
+    bool recorded;
+    //record version of the section when it was recorded
+    uint64_t version;
+    vector<PipelineImageState> start_image_states;
+    vector<PipelineBufferState> start_buffer_states;
+    vector<PipelineImageState> end_image_states;
+    vector<PipelineBufferState> end_buffer_states;
+    FlowBakedRecording(const CommandBuffer& buffer_);
+};
+
+
+/**
+ * FlowBakedSection
+ *  - Records a section, usually a FlowSectionList, into a reusable secondary command buffer once, then only executes the buffer, instead of recording the same commands every frame
+ *  - The section is recorded again when its' record version changes - push constants were written, descriptors updated or invalidate() was called -
+ *    or when descriptors start in other states than they were recorded for, because recorded barriers depend on them
+ *  - There is one buffer for each frame in flight. execute() must be called once per frame with the same number of frames in flight as the FrameContextRing,
+ *    a buffer is recorded again only once the frame that used it last has finished
+ *  - The buffer is executed outside of render passes, so it suits compute, clear and transition sections. Parallel section lists can't be baked
+ */
+class FlowBakedSection : public FlowSection{
+    //descriptor context associated with the section
+    FlowDescriptorContext& m_context;
+    unique_ptr<FlowSection> m_section;
+    CommandPool m_pool;
+    vector<FlowBakedRecording> m_recordings;
+    //index of the recording used during the current frame
+    uint32_t m_current;
+    //how many times the section was recorded
+    uint32_t m_record_count;
+public:
+    /**
+     * Create command buffers for baking the section
+     * @param ctx flow descriptor context
+     * @param section pointer to the section created with new, the baked section is responsible for deleting it
+     * @param queue_family_index family of the queue the buffers will be submitted to
+     * @param frames_in_flight how many frames can be in flight at once
+     */
+    FlowBakedSection(FlowDescriptorContext& ctx, FlowSection* section, uint32_t queue_family_index, uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT);
+
+    //Complete the baked section
+    virtual void complete();
+
+    /**
+     * Execute the recorded buffer of the current frame, record it first if the section changed or descriptors are in other states.
+     * Descriptor states are updated as if the section was recorded
+     * @param command_buffer the primary buffer to execute the section from
+     */
+    virtual void execute(CommandBuffer& command_buffer);
+
+    //The section transitions its' descriptors during execute(), returns true
+    virtual bool transitionsDuringExecute() const;
+
+    //Record version of the baked section
+    virtual uint64_t getRecordVersion() const;
+
+    //Get how many times the section was recorded so far
+    uint32_t getRecordCount() const;
+
+    //Destroy all command buffers, they may not be used by the device anymore
+    void destroy();
+private:
+    //Return true if descriptors are in the states the recording was made for
+    bool statesMatch(const FlowBakedRecording& recording) const;
+    //Record the section into given recording
+    void record(FlowBakedRecording& recording);
+};
+
+
+//Return true if two sections access the same memory through different descriptors, e.g. aliased images
+typedef std::function<bool(const FlowSection&, const FlowSection&)> FlowSectionConflict;
+
+/**
+ * Run given sections in order. Transitions of following sections that don't use descriptors of the current one are recorded together with its' own,
+ * so that consecutive sections need as few barrier commands as possible
+ * @param sections the sections to run
+ * @param buffer the buffer to record into
+ * @param flow_context descriptor context of the sections
+ * @param conflicts optional check for sections that don't share descriptors, but still must not have their transitions moved before each other
+ */
+void runSectionsBatched(const vector<FlowSection*>& sections, CommandBuffer& buffer, FlowDescriptorContext& flow_context, const FlowSectionConflict& conflicts = nullptr);
+
+
 #endif
\ No newline at end of file
@@ -23,9 +23,9 @@ PipelineBufferState::PipelineBufferState() : last_use(VK_PIPELINE_STAGE_BOTTOM_O
 
 
 
-PipelineImageState::PipelineImageState() : last_use(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+PipelineImageState::PipelineImageState() : ImageState(IMAGE_INVALID), last_use(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
 {}
-PipelineImageState::PipelineImageState(ImageState state, VkPipelineStageFlags last_use_ = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) :
+PipelineImageState::PipelineImageState(ImageState state, VkPipelineStageFlags last_use_) :
     ImageState(state), last_use(last_use_)
 {}
 
@@ -69,6 +69,8 @@ PipelineImageState& FlowDescriptorContext::getImageState(uint32_t index){return
 const PipelineImageState& FlowDescriptorContext::getImageState(uint32_t index) const{return m_image_states[index];}
 PipelineBufferState& FlowDescriptorContext::getBufferState(uint32_t index){return m_buffer_states[index];}
 const PipelineBufferState& FlowDescriptorContext::getBufferState(uint32_t index) const{return m_buffer_states[index];}
+uint32_t FlowDescriptorContext::getImageCount() const{return m_images.size();}
+uint32_t FlowDescriptorContext::getBufferCount() const{return m_buffers.size();}
 
 
 
@@ -141,6 +141,12 @@ public:
      * @param index the index of buffer, the state of which to get
      */
     const PipelineBufferState& getBufferState(uint32_t index) const;
+
+    //Get number of images in the context
+    uint32_t getImageCount() const;
+
+    //Get number of buffers in the context
+    uint32_t getBufferCount() const;
 };
 
 
@@ -82,10 +82,12 @@ void ImageSet::createImages(LocalObjectCreator& object_creator, const ImageSetOp
     //allocate memory for all images
     m_memory = ImageMemoryObject(vectorOfImages(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    //copy loaded image data to each image
+    //copy loaded image data to each image, submit all copies at once and wait for them to finish
+    object_creator.beginBatch();
     for (uint32_t i = 0; i < image_count; i++){
-        object_creator.copyToLocal(image_data[i].data.data(), image_data[i].size(), (*this)[i], ImageState{IMAGE_NEWLY_CREATED}, options.getState());
+        object_creator.copyToLocalAsync(image_data[i].data.data(), image_data[i].size(), (*this)[i], ImageState{IMAGE_NEWLY_CREATED}, options.getState());
     }
+    object_creator.wait(object_creator.endBatch());
 }
 vector<const Image*> ImageSet::vectorOfImages(){
     //allocate vector of pointers
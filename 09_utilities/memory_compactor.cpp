@@ -0,0 +1,199 @@
+#include "memory_compactor.h"
+
+#include "../01_device/allocator.h"
+#include "../03_commands/command_pool.h"
+#include <algorithm>
+
+
+CompactionReport::CompactionReport() : moved_groups(0), moved_resources(0), moved_bytes(0), reclaimed_bytes(0)
+{}
+
+
+
+RelocatableGroup::RelocatableGroup(BufferMemoryObject& memory, const vector<Buffer*>& buffers_) :
+    buffer_memory(&memory), buffers(buffers_), image_memory(nullptr), images(), image_state(IMAGE_INVALID)
+{}
+RelocatableGroup::RelocatableGroup(ImageMemoryObject& memory, const vector<Image*>& images_, ImageState state) :
+    buffer_memory(nullptr), buffers(), image_memory(&memory), images(images_), image_state(state)
+{}
+const MemoryAllocation& RelocatableGroup::getMemory() const{
+    return (buffer_memory != nullptr) ? buffer_memory->getMemory() : image_memory->getMemory();
+}
+
+
+
+TrackedDescriptor::TrackedDescriptor(DescriptorSet& set_, const DescriptorUpdateInfo& info_, const Image* image_) : set(&set_), info(info_), image(image_)
+{}
+
+
+
+MemoryCompactor::MemoryCompactor(Queue& queue, VkDeviceSize bytes_per_step) :
+    m_queue(queue), m_step(0), m_bytes_per_step(bytes_per_step), m_allocated_at_start(0)
+{
+    //command pool - make buffers individually resettable, then create one command buffer and signaled fence for each step in flight
+    m_command_buffers = CommandPoolInfo{queue.getFamilyIndex(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT}.create().allocateBuffers(COMPACTION_STEPS_IN_FLIGHT);
+    for (uint32_t i = 0; i < COMPACTION_STEPS_IN_FLIGHT; i++){
+        m_fences.push_back(SignaledFence());
+    }
+}
+void MemoryCompactor::addBuffers(BufferMemoryObject& memory, const vector<Buffer*>& buffers){
+    //mapped pointers of shared objects would keep pointing to the old memory, and host writes could race with the copy
+    if (memory.getPropertyFlags() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+        PRINT_WARN("Host visible memory can't be relocated, skipping memory object")
+        return;
+    }
+    //queue family indices aren't kept after creation, buffers shared between families can't be recreated
+    for (const Buffer* buffer : buffers){
+        if (buffer->getCreateInfo().sharingMode == VK_SHARING_MODE_CONCURRENT){
+            PRINT_WARN("Buffers with concurrent sharing mode can't be relocated, skipping memory object")
+            return;
+        }
+    }
+    m_groups.push_back(RelocatableGroup(memory, buffers));
+}
+void MemoryCompactor::addImages(ImageMemoryObject& memory, const vector<Image*>& images, ImageState state){
+    for (const Image* image : images){
+        if (image->getCreateInfo().sharingMode == VK_SHARING_MODE_CONCURRENT){
+            PRINT_WARN("Images with concurrent sharing mode can't be relocated, skipping memory object")
+            return;
+        }
+    }
+    m_groups.push_back(RelocatableGroup(memory, images, state));
+}
+void MemoryCompactor::trackDescriptor(DescriptorSet& set, const DescriptorUpdateInfo& info, const Image* image){
+    m_descriptors.push_back(TrackedDescriptor(set, info, image));
+}
+void MemoryCompactor::start(){
+    m_allocated_at_start = g_allocator.get().getTotalStatistics().allocated_bytes;
+    m_report = CompactionReport();
+    //consider all groups that have memory, order them by how full their block is, the group in the emptiest block is moved first
+    m_pending.clear();
+    vector<VkDeviceSize> block_usage(m_groups.size());
+    for (uint32_t i = 0; i < m_groups.size(); i++){
+        if (!m_groups[i].getMemory().valid()) continue;
+        block_usage[i] = g_allocator.get().getBlockUsedSize(m_groups[i].getMemory().memory);
+        m_pending.push_back(i);
+    }
+    std::sort(m_pending.begin(), m_pending.end(), [&block_usage](uint32_t a, uint32_t b){
+        return block_usage[a] > block_usage[b];
+    });
+}
+bool MemoryCompactor::step(){
+    if (m_pending.empty()) return true;
+    //use the oldest command buffer, wait until its' last step finishes
+    CommandBuffer& command_buffer = m_command_buffers[m_step % COMPACTION_STEPS_IN_FLIGHT];
+    Fence& fence = m_fences[m_step % COMPACTION_STEPS_IN_FLIGHT];
+    if (!fence.waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for compaction step expired")
+    fence.reset();
+    command_buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    //move groups from the emptiest blocks until enough bytes were copied
+    VkDeviceSize copied = 0;
+    while (!m_pending.empty() && copied < m_bytes_per_step){
+        RelocatableGroup& group = m_groups[m_pending.back()];
+        m_pending.pop_back();
+        copied += relocate(group, command_buffer);
+    }
+    command_buffer.endRecord();
+    //submit the copies, they run before anything the application submits afterwards
+    SubmitSynchronization step_synchronization;
+    step_synchronization.setEndFence(fence);
+    m_queue.submit(command_buffer, step_synchronization);
+    m_step++;
+    return m_pending.empty();
+}
+bool MemoryCompactor::finished() const{
+    return m_pending.empty();
+}
+const CompactionReport& MemoryCompactor::getReport(){
+    VkDeviceSize allocated = g_allocator.get().getTotalStatistics().allocated_bytes;
+    m_report.reclaimed_bytes = (allocated < m_allocated_at_start) ? m_allocated_at_start - allocated : 0;
+    return m_report;
+}
+VkDeviceSize MemoryCompactor::relocate(RelocatableGroup& group, CommandBuffer& command_buffer){
+    VkDeviceSize moved = (group.buffer_memory != nullptr) ? relocateBuffers(group, command_buffer) : relocateImages(group, command_buffer);
+    if (moved != 0){
+        m_report.moved_groups++;
+        m_report.moved_bytes += moved;
+    }
+    return moved;
+}
+VkDeviceSize MemoryCompactor::relocateBuffers(RelocatableGroup& group, CommandBuffer& command_buffer){
+    BufferMemoryObject& memory = *group.buffer_memory;
+    MemoryAllocation new_memory = g_allocator.get().allocateForRelocation(memory.getMemory(), memory.getAlignment(), MEMORY_RESOURCE_LINEAR);
+    if (!new_memory.valid()) return 0;
+    for (uint32_t i = 0; i < group.buffers.size(); i++){
+        Buffer& buffer = *group.buffers[i];
+        //create a buffer with the same parameters and bind it to the same offset inside the new allocation
+        Buffer new_buffer(g_allocator.get().createBuffer(buffer.getCreateInfo()), buffer.getCreateInfo());
+        VkResult result = vkBindBufferMemory(g_device, new_buffer, new_memory.memory, new_memory.offset + memory.getBufferOffset(i));
+        DEBUG_CHECK("Relocated buffer memory binding", result)
+        //wait for all previous writes, copy the contents, then make them visible to all following commands
+        command_buffer.cmdBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, buffer.createMemoryBarrier(VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+        command_buffer.cmdCopyFromBuffer(buffer, new_buffer);
+        command_buffer.cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            new_buffer.createMemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT));
+        //the old buffer is destroyed after the current frame, everything recorded from now on uses the new one
+        g_allocator.get().releaseBuffer(buffer);
+        patchDescriptors(buffer, new_buffer);
+        buffer.rebind(new_buffer);
+        m_report.moved_resources++;
+    }
+    memory.rebind(new_memory);
+    return new_memory.size;
+}
+VkDeviceSize MemoryCompactor::relocateImages(RelocatableGroup& group, CommandBuffer& command_buffer){
+    ImageMemoryObject& memory = *group.image_memory;
+    MemoryAllocation new_memory = g_allocator.get().allocateForRelocation(memory.getMemory(), memory.getAlignment(), MEMORY_RESOURCE_OPTIMAL);
+    if (!new_memory.valid()) return 0;
+    ImageState transfer_src(IMAGE_TRANSFER_SRC), transfer_dst(IMAGE_TRANSFER_DST);
+    //images in the newly created state have no contents to copy
+    bool copy = (group.image_state.layout != VK_IMAGE_LAYOUT_UNDEFINED);
+    for (uint32_t i = 0; i < group.images.size(); i++){
+        //images with dedicated memory stay where they are
+        if (memory.getImageOffset(i) == VK_WHOLE_SIZE) continue;
+        Image& image = *group.images[i];
+        Image new_image(g_allocator.get().createImage(image.getCreateInfo()), image.getCreateInfo());
+        VkResult result = vkBindImageMemory(g_device, new_image, new_memory.memory, new_memory.offset + memory.getImageOffset(i));
+        DEBUG_CHECK("Relocated image memory binding", result)
+        if (copy){
+            //move the old image to transfer source and the new one to transfer destination, copy all levels and layers, then return the new image to the original state
+            command_buffer.cmdBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                vector<VkImageMemoryBarrier>{image.createMemoryBarrier(group.image_state, transfer_src), new_image.createMemoryBarrier(IMAGE_NEWLY_CREATED, transfer_dst)});
+            command_buffer.cmdCopyImage(image, new_image);
+            command_buffer.cmdBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, new_image.createMemoryBarrier(transfer_dst, group.image_state));
+        }
+        g_allocator.get().releaseImage(image);
+        image.rebind(new_image);
+        patchDescriptors(image);
+        m_report.moved_resources++;
+    }
+    memory.rebind(new_memory);
+    return new_memory.size;
+}
+void MemoryCompactor::patchDescriptors(VkBuffer old_buffer, VkBuffer new_buffer){
+    for (TrackedDescriptor& descriptor : m_descriptors){
+        VkDescriptorBufferInfo* info = descriptor.info.bufferInfo();
+        if (info == nullptr || info->buffer != old_buffer) continue;
+        info->buffer = new_buffer;
+        descriptor.set->updateDescriptorsV({descriptor.info});
+    }
+}
+void MemoryCompactor::patchDescriptors(const Image& image){
+    //old views become invalid with the old image, one new view replaces each of them
+    vector<std::pair<VkImageView, VkImageView>> replaced_views;
+    for (TrackedDescriptor& descriptor : m_descriptors){
+        VkDescriptorImageInfo* info = descriptor.info.imageInfo();
+        if (descriptor.image != &image || info == nullptr) continue;
+        VkImageView new_view = VK_NULL_HANDLE;
+        for (const std::pair<VkImageView, VkImageView>& views : replaced_views){
+            if (views.first == info->imageView) new_view = views.second;
+        }
+        if (new_view == VK_NULL_HANDLE){
+            new_view = image.createView();
+            replaced_views.push_back({info->imageView, new_view});
+            g_allocator.get().releaseImageView(info->imageView);
+        }
+        info->imageView = new_view;
+        descriptor.set->updateDescriptorsV({descriptor.info});
+    }
+}
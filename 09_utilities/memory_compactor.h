@@ -0,0 +1,167 @@
+#ifndef MEMORY_COMPACTOR_H
+#define MEMORY_COMPACTOR_H
+
+/**
+ * memory_compactor.h
+ *  - Holds a service that moves long-lived buffers and images out of sparsely used memory blocks, so the blocks can be released
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "../01_device/device.h"
+#include "../03_commands/command_buffer.h"
+#include "../03_commands/synchronization.h"
+#include "../04_memory_objects/buffer.h"
+#include "../04_memory_objects/image.h"
+#include "../07_shaders/pipelines_context.h"
+
+
+//how many compaction steps can be executed on the GPU at once
+const uint32_t COMPACTION_STEPS_IN_FLIGHT = 3;
+//default number of bytes copied during one compaction step
+const VkDeviceSize COMPACTION_BYTES_PER_STEP = 32 * 1024 * 1024;
+
+
+/**
+ * CompactionReport
+ *  - Results of one compaction pass
+ */
+class CompactionReport{
+public:
+    //how many memory objects were moved
+    uint32_t moved_groups;
+    //how many buffers and images were recreated
+    uint32_t moved_resources;
+    //size of all moved allocations in bytes
+    VkDeviceSize moved_bytes;
+    //how much less memory is allocated than before the pass started. Old allocations are released only after the frame finishes, the value grows until then
+    VkDeviceSize reclaimed_bytes;
+    CompactionReport();
+};
+
+
+/**
+ * RelocatableGroup
+ *  - One memory object registered in the MemoryCompactor together with all resources bound to it
+ */
+class RelocatableGroup{
+public:
+    //exactly one of buffer_memory and image_memory is valid
+    BufferMemoryObject* buffer_memory;
+    vector<Buffer*> buffers;
+    ImageMemoryObject* image_memory;
+    vector<Image*> images;
+    //state the images are in when compaction steps run, they are returned to the same state after copying
+    ImageState image_state;
+
+    RelocatableGroup(BufferMemoryObject& memory, const vector<Buffer*>& buffers_);
+    RelocatableGroup(ImageMemoryObject& memory, const vector<Image*>& images_, ImageState state);
+
+    //get the allocation the resources are currently bound to
+    const MemoryAllocation& getMemory() const;
+};
+
+
+/**
+ * TrackedDescriptor
+ *  - One descriptor that is rewritten when the resource it points to is moved
+ */
+class TrackedDescriptor{
+public:
+    DescriptorSet* set;
+    DescriptorUpdateInfo info;
+    //image viewed by the descriptor, nullptr for buffer descriptors
+    const Image* image;
+    TrackedDescriptor(DescriptorSet& set_, const DescriptorUpdateInfo& info_, const Image* image_);
+};
+
+
+/**
+ * MemoryCompactor
+ *  - Moves registered buffers and images from the emptiest memory blocks into fuller ones, so that empty blocks can be returned to the driver
+ *  - Vulkan resources can't be bound to other memory, every moved resource is recreated with its' original create info, its' contents are copied on the GPU,
+ *    then the old resource and memory are released. The Buffer and Image objects passed in are updated to hold the new handles.
+ *  - Copies are spread over multiple frames, one step() copies at most bytes_per_step bytes
+ *  - Registered descriptors are rewritten to point to the moved resources. Image descriptors get a new view with the image format and type.
+ *  - Copies of the Buffer and Image objects, buffer views, other image views and framebuffers aren't updated. Resources referenced by them should not be registered
+ */
+class MemoryCompactor{
+    Queue& m_queue;
+    //command buffers and fences, used in a circle
+    vector<CommandBuffer> m_command_buffers;
+    vector<Fence> m_fences;
+    //number of steps submitted so far
+    uint32_t m_step;
+    VkDeviceSize m_bytes_per_step;
+    vector<RelocatableGroup> m_groups;
+    vector<TrackedDescriptor> m_descriptors;
+    //indices of groups that weren't considered for moving yet during current pass, the group in the emptiest block is the last one
+    vector<uint32_t> m_pending;
+    //allocated bytes of the whole device when current pass started
+    VkDeviceSize m_allocated_at_start;
+    CompactionReport m_report;
+public:
+    /**
+     * Create a memory compactor.
+     * @param queue the queue to copy on, it should be the queue the resources are used on, so copies are ordered with rendering
+     * @param bytes_per_step maximum number of bytes to copy during one step
+     */
+    MemoryCompactor(Queue& queue, VkDeviceSize bytes_per_step = COMPACTION_BYTES_PER_STEP);
+
+    /**
+     * Register a buffer memory object that can be moved. Objects in host visible memory are skipped, their mapped pointers can't follow the move
+     * @param memory the memory object
+     * @param buffers all buffers bound to it, in the order they were passed to its' constructor
+     */
+    void addBuffers(BufferMemoryObject& memory, const vector<Buffer*>& buffers);
+
+    /**
+     * Register an image memory object that can be moved. Images with dedicated memory are never moved
+     * @param memory the memory object
+     * @param images all images bound to it, in the order they were passed to its' constructor
+     * @param state state the images are in when steps run
+     */
+    void addImages(ImageMemoryObject& memory, const vector<Image*>& images, ImageState state);
+
+    /**
+     * Register a descriptor that should be rewritten when the resource it points to is moved.
+     * @param set the set containing the descriptor
+     * @param info info the descriptor was last updated with
+     * @param image the image the descriptor views, nullptr for buffer descriptors
+     */
+    void trackDescriptor(DescriptorSet& set, const DescriptorUpdateInfo& info, const Image* image = nullptr);
+
+    //Start a new compaction pass - all registered groups will be considered for moving during the following steps
+    void start();
+
+    /**
+     * Move the next groups, up to bytes_per_step bytes, return true when the pass is finished.
+     * Call once per frame before recording the commands of the frame, the queue is submitted to immediately. Tracked descriptor sets are updated,
+     * they must not be in use by the device. Old resources are released and destroyed after the current frame, see VulkanAllocator::endFrame.
+     */
+    bool step();
+
+    //return true if all groups were considered during current pass
+    bool finished() const;
+
+    //Get results of the current pass
+    const CompactionReport& getReport();
+private:
+    //Move one group, record copy commands into command buffer. Return number of bytes moved, 0 if the group couldn't be moved to a fuller block
+    VkDeviceSize relocate(RelocatableGroup& group, CommandBuffer& command_buffer);
+
+    //Move one group of buffers
+    VkDeviceSize relocateBuffers(RelocatableGroup& group, CommandBuffer& command_buffer);
+
+    //Move one group of images
+    VkDeviceSize relocateImages(RelocatableGroup& group, CommandBuffer& command_buffer);
+
+    //Point all tracked descriptors using old buffer to the new one
+    void patchDescriptors(VkBuffer old_buffer, VkBuffer new_buffer);
+
+    //Create new views for all tracked descriptors viewing given image
+    void patchDescriptors(const Image& image);
+};
+
+
+#endif
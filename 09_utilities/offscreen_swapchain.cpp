@@ -0,0 +1,142 @@
+#include "offscreen_swapchain.h"
+#include "../01_device/device.h"
+#include "../03_commands/synchronization.h"
+#include "../06_render_passes/framebuffer.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+
+OffscreenSwapchain::OffscreenSwapchain(Queue& queue, uint32_t width, uint32_t height, uint32_t image_count, VkFormat format, VkImageUsageFlags usage) :
+    m_queue(queue), m_image_info(width, height, format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | usage),
+    m_next_image(0), m_acquired_image(IMAGE_INDEX_INVALID), m_presented_count(0), m_reader(), m_readbacks(image_count), m_presented_state(IMAGE_COLOR_ATTACHMENT)
+{
+    //create all images, then allocate memory for them at once
+    for (uint32_t i = 0; i < image_count; i++){
+        m_images.push_back(m_image_info.createImage());
+    }
+    m_image_memory = ImageMemoryObject(m_images, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+void OffscreenSwapchain::enableReadback(const string& file_prefix, ImageState presented_state){
+    m_file_prefix = file_prefix;
+    m_presented_state = presented_state;
+    //staging memory for as many images as can be read at once
+    VkDeviceSize image_size = m_images[0].getSizeInBytes();
+    uint32_t images_in_flight = std::min(getImageCount(), READBACKS_IN_FLIGHT);
+    //images are aligned to 4 texels in the staging buffer, add space for padding
+    m_reader = unique_ptr<LocalObjectReader>(new LocalObjectReader(m_queue, images_in_flight * (image_size + 4ULL * m_images[0].getFormat().getSize())));
+}
+SwapchainImage OffscreenSwapchain::acquireImage(){
+    //images are used in a circle, there is always one available
+    m_acquired_image = m_next_image;
+    m_next_image = (m_next_image + 1) % getImageCount();
+    return SwapchainImage{m_images[m_acquired_image], m_framebuffers.empty() ? VK_NULL_HANDLE : m_framebuffers[m_acquired_image], m_acquired_image};
+}
+SwapchainImage OffscreenSwapchain::acquireImage(VkSemaphore signal_semaphore, nanoseconds){
+    SwapchainImage image = acquireImage();
+    prepareToDraw();
+    //the image is ready now, nothing has to run before the semaphore is signaled
+    SubmitSynchronization synchronization;
+    synchronization.addEndSemaphore(signal_semaphore);
+    VkSubmitInfo submit_info = synchronization.getSubmitInfo(nullptr, 0);
+    VkResult result = vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE);
+    DEBUG_CHECK("Offscreen image semaphore signal", result)
+    return image;
+}
+void OffscreenSwapchain::prepareToDraw(){
+    //the image can be drawn into once the copy of its' previous contents finishes
+    if (m_reader && m_acquired_image != IMAGE_INDEX_INVALID){
+        m_reader->waitFor(m_readbacks[m_acquired_image]);
+    }
+}
+void OffscreenSwapchain::presentImage(const SwapchainImage& img, const Queue&){
+    uint64_t frame = m_presented_count++;
+    if (!m_reader) return;
+    //deliver finished copies of older frames first, so files are written as soon as possible
+    m_reader->poll();
+    //file name with the frame number padded to 6 digits
+    std::stringstream filename;
+    filename << m_file_prefix << std::setw(6) << std::setfill('0') << frame;
+    uint32_t width = getWidth(), height = getHeight();
+    VkFormat format = getFormat();
+    string name = filename.str();
+    m_readbacks[img.getIndex()] = m_reader->copyFromLocalAsync(m_images[img.getIndex()], m_presented_state, m_presented_state,
+        [name, width, height, format](const uint8_t* data, VkDeviceSize size){
+            if (!writeImageFile(name, data, size, width, height, format)) PRINT_ERROR("Could not write frame to file: " << name)
+        });
+}
+void OffscreenSwapchain::presentImage(const SwapchainImage& img, const Queue& queue, VkSemaphore wait_semaphore){
+    //consume the semaphore, the rendering it stands for was submitted to the queue before, so the barriers of the copy order it after the rendering
+    SubmitSynchronization synchronization;
+    synchronization.addStartSemaphore(wait_semaphore, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    VkSubmitInfo submit_info = synchronization.getSubmitInfo(nullptr, 0);
+    VkResult result = vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE);
+    DEBUG_CHECK("Offscreen image semaphore wait", result)
+    presentImage(img, queue);
+}
+void OffscreenSwapchain::createFramebuffers(VkRenderPass render_pass, VkImageView depth_attachment, uint32_t layer_count){
+    //create views only once, framebuffers can be created again for a different render pass
+    if (m_views.empty()){
+        for (const Image& image : m_images){
+            m_views.push_back(image.createView());
+        }
+    }
+    m_framebuffers.resize(m_images.size(), VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < m_images.size(); i++){
+        m_framebuffers[i] = FramebufferInfo(getWidth(), getHeight(),
+            depth_attachment == VK_NULL_HANDLE ? vector<VkImageView>{m_views[i]} : vector<VkImageView>{m_views[i], depth_attachment},
+            render_pass).setLayerCount(layer_count).create();
+    }
+}
+void OffscreenSwapchain::waitAll(){
+    if (m_reader) m_reader->waitAll();
+}
+Image& OffscreenSwapchain::getImage(uint32_t index){
+    return m_images[index];
+}
+uint32_t OffscreenSwapchain::getImageCount() const{
+    return m_images.size();
+}
+uint32_t OffscreenSwapchain::getWidth() const{
+    return m_image_info.get().extent.width;
+}
+uint32_t OffscreenSwapchain::getHeight() const{
+    return m_image_info.get().extent.height;
+}
+VkFormat OffscreenSwapchain::getFormat() const{
+    return m_image_info.get().format;
+}
+void OffscreenSwapchain::free(){
+    waitAll();
+    m_image_memory.free();
+}
+
+
+
+bool writeImageFile(const string& filename, const uint8_t* data, VkDeviceSize size, uint32_t width, uint32_t height, VkFormat format){
+    bool rgba = (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB);
+    bool bgra = (format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB);
+    //formats without a simple image file equivalent are written as they are
+    if (!rgba && !bgra){
+        std::ofstream file(filename + ".raw", std::ios::binary);
+        if (!file) return false;
+        file.write(reinterpret_cast<const char*>(data), size);
+        return true;
+    }
+    std::ofstream file(filename + ".pam", std::ios::binary);
+    if (!file) return false;
+    //PAM header, then pixels in RGBA order
+    file << "P7\nWIDTH " << width << "\nHEIGHT " << height << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    if (rgba){
+        file.write(reinterpret_cast<const char*>(data), size);
+    }else{
+        //swap red and blue channels
+        vector<uint8_t> pixels(data, data + size);
+        for (VkDeviceSize i = 0; i + 3 < size; i += 4){
+            std::swap(pixels[i], pixels[i + 2]);
+        }
+        file.write(reinterpret_cast<const char*>(pixels.data()), size);
+    }
+    return true;
+}
@@ -0,0 +1,117 @@
+#ifndef OFFSCREEN_SWAPCHAIN_H
+#define OFFSCREEN_SWAPCHAIN_H
+
+
+/**
+ * offscreen_swapchain.h
+ *  - OffscreenSwapchain class, a drop-in replacement for Swapchain when rendering without a window
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "../01_device/device.h"
+#include "../02_swapchain/swapchain.h"
+#include "../04_memory_objects/image_info.h"
+#include "../04_memory_objects/local_object_reader.h"
+#include <memory>
+
+using std::unique_ptr;
+
+
+/**
+ * OffscreenSwapchain
+ *  - Holds a ring of images that is used the same way as a Swapchain - images are acquired, drawn into using framebuffers from createFramebuffers(), then presented
+ *  - The images are plain device local images, no window, surface or VK_KHR_swapchain is needed, so it can be used on headless machines and software renderers
+ *  - Presenting an image optionally copies it back to the CPU and writes it to disk. Copies run asynchronously, an image can be acquired again only after its' copy finishes
+ *  - Semaphores passed to acquire and present are signaled and waited for by empty submits to the queue, so code written for Swapchain works unchanged
+ *  - Render passes drawing into the images must end in the presented state given to enableReadback (IMAGE_COLOR_ATTACHMENT by default), not in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+ */
+class OffscreenSwapchain{
+    //the queue images are drawn on, readback copies and empty submits for semaphores go to it
+    Queue& m_queue;
+    ImageInfo m_image_info;
+    vector<Image> m_images;
+    ImageMemoryObject m_image_memory;
+    vector<VkImageView> m_views;
+    vector<VkFramebuffer> m_framebuffers;
+    //index of the image that will be acquired next
+    uint32_t m_next_image;
+    //index of the last acquired image
+    uint32_t m_acquired_image;
+    //number of images presented so far
+    uint64_t m_presented_count;
+
+    //reads presented images back to the CPU, nullptr if readback isn't enabled
+    unique_ptr<LocalObjectReader> m_reader;
+    //last readback of each image, an image is reused only after its' readback finishes
+    vector<ReadbackToken> m_readbacks;
+    //state images are in when presented
+    ImageState m_presented_state;
+    //files are named <prefix><frame number>.pam, or .raw for formats that aren't 8 bit RGBA/BGRA
+    string m_file_prefix;
+public:
+    /**
+     * Create offscreen images
+     * @param queue the queue the images are drawn on
+     * @param width image width
+     * @param height image height
+     * @param image_count how many images to create, the same as the swapchain image count
+     * @param format image format, 8 bit RGBA or BGRA formats can be written to disk as images
+     * @param usage additional usages, color attachment and transfer source usages are always set
+     */
+    OffscreenSwapchain(Queue& queue, uint32_t width, uint32_t height, uint32_t image_count = 3, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM, VkImageUsageFlags usage = 0);
+
+    /**
+     * Copy every presented image to the CPU and write it to disk
+     * @param file_prefix path and beginning of the file name, e.g. "output/frame_"
+     * @param presented_state state images are in when presented - the final layout of the render pass and its' last access
+     */
+    void enableReadback(const string& file_prefix, ImageState presented_state = IMAGE_COLOR_ATTACHMENT);
+
+    //Acquire an image to draw into. Images are used in a circle
+    SwapchainImage acquireImage();
+
+    /**
+     * Acquire an image and signal the semaphore, the same as Swapchain::acquireImage. Waits on the CPU until the readback of the image finishes, prepareToDraw() isn't needed
+     * @param signal_semaphore semaphore signaled by an empty submit to the queue
+     * @param timeout unused, an image is always available once its' readback finishes
+     */
+    SwapchainImage acquireImage(VkSemaphore signal_semaphore, nanoseconds timeout = A_SHORT_WHILE);
+
+    //Wait until the acquired image isn't being read anymore
+    void prepareToDraw();
+
+    /**
+     * Finish drawing into the image. If readback is enabled, the copy is submitted after all work submitted so far.
+     * @param img the image to present
+     * @param queue unused, kept for compatibility with Swapchain::presentImage, copies are submitted to the queue given to the constructor
+     */
+    void presentImage(const SwapchainImage& img, const Queue& queue);
+
+    //Present the image once the semaphore is signaled, the same as Swapchain::presentImage. The semaphore is waited for by an empty submit, the copy is submitted after it
+    void presentImage(const SwapchainImage& img, const Queue& queue, VkSemaphore wait_semaphore);
+
+    //Create framebuffers for all images, using given render_pass and depth attachment, if needed
+    void createFramebuffers(VkRenderPass render_pass, VkImageView depth_attachment = VK_NULL_HANDLE, uint32_t layer_count = 1);
+
+    //Wait until all presented images are written to disk
+    void waitAll();
+
+    //Get image with given index, e.g. to read it in a custom way
+    Image& getImage(uint32_t index);
+    uint32_t getImageCount() const;
+    uint32_t getWidth() const;
+    uint32_t getHeight() const;
+    VkFormat getFormat() const;
+
+    //Wait for all readbacks, then return memory of the images to the allocator
+    void free();
+};
+
+
+
+//Write 8 bit RGBA or BGRA data to a PAM file, other formats are written as raw bytes. Return false if the file couldn't be opened
+bool writeImageFile(const string& filename, const uint8_t* data, VkDeviceSize size, uint32_t width, uint32_t height, VkFormat format);
+
+
+#endif
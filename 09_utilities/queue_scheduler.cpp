@@ -0,0 +1,279 @@
+#include "queue_scheduler.h"
+#include <algorithm>
+#include <map>
+
+using std::map;
+using std::pair;
+
+
+//identifies a descriptor in the descriptor context - whether it is an image, and its' index
+using DescriptorKey = pair<bool, int>;
+
+
+//dependency between positions on different queues. Position -1 is the main queue before the first section, section count is the main queue after the last one
+class FlowQueueEdge{
+public:
+    int producer;
+    int consumer;
+    //usage of the descriptor by the consumer, nullptr if the edge only orders execution
+    const FlowSectionDescriptorUsage* usage;
+    FlowQueueEdge(int producer_, int consumer_, const FlowSectionDescriptorUsage* usage_) : producer(producer_), consumer(consumer_), usage(usage_)
+    {}
+};
+
+
+
+FlowQueueBatch::FlowQueueBatch(FlowQueue queue_) : queue(queue_), wait_batch(-1), wait_stages(0)
+{}
+
+
+
+FlowQueueScheduler::FlowQueueScheduler(FlowDescriptorContext& ctx, Queue& main_queue, Queue& compute_queue, uint32_t frames_in_flight) :
+    m_context(ctx), m_main_queue(main_queue), m_compute_queue(compute_queue), m_transfer_ownership(main_queue.getFamilyIndex() != compute_queue.getFamilyIndex()),
+    m_main_allocator(main_queue.getFamilyIndex(), frames_in_flight), m_compute_allocator(compute_queue.getFamilyIndex(), frames_in_flight),
+    m_fences(frames_in_flight), m_semaphores(frames_in_flight), m_frame(0), m_completed(false)
+{}
+uint32_t FlowQueueScheduler::addSection(FlowSection* section, FlowQueue queue){
+    if (m_completed){
+        PRINT_ERROR("Sections can't be added to a completed queue scheduler")
+        throw std::runtime_error("Sections can't be added to a completed queue scheduler");
+    }
+    //descriptors used by nested sections aren't known, they can't be moved to the other queue
+    if (queue == FLOW_QUEUE_ASYNC_COMPUTE && section->transitionsDuringExecute()){
+        PRINT_WARN("Sections that transition during execution can't run on the async compute queue, running on the main queue")
+        queue = FLOW_QUEUE_MAIN;
+    }
+    //there is nothing to overlap with only one queue
+    if ((VkQueue) m_main_queue == (VkQueue) m_compute_queue) queue = FLOW_QUEUE_MAIN;
+    m_sections.emplace_back(section);
+    m_queues.push_back(queue);
+    return m_sections.size() - 1;
+}
+void FlowQueueScheduler::complete(){
+    int count = m_sections.size();
+    vector<FlowQueueEdge> edges;
+    //last position that used each descriptor and its' usage there. Descriptors that weren't used yet are owned by the main queue
+    map<DescriptorKey, pair<int, const FlowSectionDescriptorUsage*>> last_use;
+    //last async section, last section that transitions during execution
+    int last_async = -1, last_sync = -1;
+    //async sections that have to start a new batch, because they come after a section transitioning during execution
+    vector<bool> after_sync(count, false);
+    vector<bool> is_sync(count, false);
+    for (int p = 0; p < count; p++){
+        FlowSection& section = *m_sections[p];
+        if (section.transitionsDuringExecute()){
+            //all compute work declared before has to finish
+            if (last_async != -1) edges.push_back(FlowQueueEdge(last_async, p, nullptr));
+            is_sync[p] = true;
+            last_sync = p;
+            continue;
+        }
+        FlowQueue queue = getQueue(p);
+        if (queue == FLOW_QUEUE_ASYNC_COMPUTE && last_sync > last_async) after_sync[p] = true;
+        for (const FlowSectionDescriptorUsage& d : section.getDescriptorUsages()){
+            DescriptorKey key{d.isImage(), d.descriptor_index};
+            auto last = last_use.find(key);
+            int previous = (last == last_use.end()) ? -1 : last->second.first;
+            //the descriptor changes queues
+            if (getQueue(previous) != queue) edges.push_back(FlowQueueEdge(previous, p, &d));
+            last_use[key] = {p, &d};
+        }
+        if (queue == FLOW_QUEUE_ASYNC_COMPUTE) last_async = p;
+    }
+    //descriptors last used by the compute queue are returned to the main queue, which also waits for all compute work before the end
+    for (const auto& last : last_use){
+        if (getQueue(last.second.first) == FLOW_QUEUE_ASYNC_COMPUTE) edges.push_back(FlowQueueEdge(last.second.first, count, last.second.second));
+    }
+    if (last_async != -1) edges.push_back(FlowQueueEdge(last_async, count, nullptr));
+
+    //positions are shifted by one, so that the position before the first section has index 0
+    vector<bool> incoming(count + 2, false), outgoing(count + 2, false);
+    for (const FlowQueueEdge& e : edges){
+        outgoing[e.producer + 1] = true;
+        incoming[e.consumer + 1] = true;
+    }
+    //a new batch starts at a section that waits for the other queue, and after a section the other queue waits for.
+    //Batches are created in declaration order, a batch is always submitted after the batches it waits for
+    m_batches.clear();
+    vector<int> batch_of(count + 2, -1);
+    int current[2] = {-1, -1};
+    bool split[2] = {false, false};
+    if (outgoing[0]){
+        m_batches.push_back(FlowQueueBatch(FLOW_QUEUE_MAIN));
+        batch_of[0] = current[FLOW_QUEUE_MAIN] = 0;
+        split[FLOW_QUEUE_MAIN] = true;
+    }
+    for (int p = 0; p < count; p++){
+        FlowQueue queue = getQueue(p);
+        if (current[queue] == -1 || split[queue] || incoming[p + 1] || after_sync[p]){
+            m_batches.push_back(FlowQueueBatch(queue));
+            current[queue] = m_batches.size() - 1;
+        }
+        m_batches[current[queue]].sections.push_back(m_sections[p].get());
+        batch_of[p + 1] = current[queue];
+        //compute work declared after a section transitioning during execution waits for it
+        split[queue] = outgoing[p + 1] || (is_sync[p] && last_async > p);
+    }
+    if (incoming[count + 1] || m_batches.empty()){
+        m_batches.push_back(FlowQueueBatch(FLOW_QUEUE_MAIN));
+        batch_of[count + 1] = m_batches.size() - 1;
+    }
+
+    for (const FlowQueueEdge& e : edges){
+        int producer = batch_of[e.producer + 1];
+        FlowQueueBatch& consumer = m_batches[batch_of[e.consumer + 1]];
+        consumer.wait_batch = std::max(consumer.wait_batch, producer);
+        if (e.usage == nullptr){
+            consumer.wait_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            continue;
+        }
+        FlowSectionDescriptorUsage usage = *e.usage;
+        //after the last section, the descriptor can be used by anything
+        if (e.consumer == count) usage.usage_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        m_batches[producer].releases.push_back(usage);
+        consumer.acquires.push_back(usage);
+        consumer.wait_stages |= usage.usage_stages;
+    }
+    //waits of compute batches for sections transitioning during execution
+    int sync_batch = -1;
+    for (uint32_t b = 0; b < m_batches.size(); b++){
+        FlowQueueBatch& batch = m_batches[b];
+        if (batch.queue == FLOW_QUEUE_MAIN){
+            for (int p = 0; p < count; p++){
+                if (is_sync[p] && batch_of[p + 1] == (int) b) sync_batch = b;
+            }
+        }else if (sync_batch != -1){
+            batch.wait_batch = std::max(batch.wait_batch, sync_batch);
+            batch.wait_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        }
+    }
+    //each waiting batch gets its' own semaphore, a binary semaphore can be waited for only once
+    for (uint32_t b = 0; b < m_batches.size(); b++){
+        if (m_batches[b].wait_batch != -1) m_batches[m_batches[b].wait_batch].signal_batches.push_back(b);
+    }
+    for (vector<Semaphore>& semaphores : m_semaphores){
+        semaphores.resize(m_batches.size());
+    }
+
+    for (unique_ptr<FlowSection>& section : m_sections){
+        section->complete();
+    }
+    m_completed = true;
+}
+void FlowQueueScheduler::submit(const SubmitSynchronization& synchronization){
+    if (!m_completed){
+        PRINT_ERROR("Queue scheduler has to be completed before submission")
+        return;
+    }
+    //command buffers and semaphores are reused once the execution that used them finishes. Allocators wait for the fence, it is reset afterwards
+    m_frame = (m_frame + 1) % m_fences.size();
+    m_main_allocator.beginFrame();
+    m_compute_allocator.beginFrame();
+    if (!m_fences[m_frame].waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for previous execution expired")
+    m_fences[m_frame].reset();
+    vector<Semaphore>& semaphores = m_semaphores[m_frame];
+
+    bool first_main = true;
+    for (uint32_t b = 0; b < m_batches.size(); b++){
+        const FlowQueueBatch& batch = m_batches[b];
+        bool main = (batch.queue == FLOW_QUEUE_MAIN);
+        CommandBuffer buffer = main ? m_main_allocator.allocate() : m_compute_allocator.allocate();
+        buffer.startRecordPrimary(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        acquire(batch, buffer);
+        runSectionsBatched(batch.sections, buffer, m_context);
+        release(batch, buffer);
+        buffer.endRecord();
+
+        SubmitSynchronization batch_synchronization;
+        if (batch.wait_batch != -1) batch_synchronization.addStartSemaphore(semaphores[b], batch.wait_stages);
+        for (uint32_t s : batch.signal_batches) batch_synchronization.addEndSemaphore(semaphores[s]);
+        if (main && first_main){
+            for (uint32_t i = 0; i < synchronization.getStartSemaphoreCount(); i++){
+                batch_synchronization.addStartSemaphore(synchronization.getStartSemaphores()[i], synchronization.getStartSemaphoresStageFlags()[i]);
+            }
+            first_main = false;
+        }
+        //the last batch is on the main queue and waits for all compute work
+        if (b + 1 == m_batches.size()){
+            for (uint32_t i = 0; i < synchronization.getEndSemaphoreCount(); i++){
+                batch_synchronization.addEndSemaphore(synchronization.getEndSemaphores()[i]);
+            }
+            batch_synchronization.setEndFence(m_fences[m_frame]);
+        }
+        (main ? m_main_queue : m_compute_queue).submit(buffer, batch_synchronization);
+    }
+    //a submit without command buffers signals the fence of the caller once everything submitted to the main queue so far finishes
+    if (synchronization.hasEndFence()){
+        VkResult result = vkQueueSubmit(m_main_queue, 0, nullptr, synchronization.getEndFence());
+        DEBUG_CHECK("Submit end fence", result)
+    }
+    m_main_allocator.endFrame(m_fences[m_frame]);
+    m_compute_allocator.endFrame(m_fences[m_frame]);
+}
+uint32_t FlowQueueScheduler::getBatchCount() const{
+    return m_batches.size();
+}
+const vector<FlowQueueBatch>& FlowQueueScheduler::getBatches() const{
+    return m_batches;
+}
+void FlowQueueScheduler::waitAll(){
+    for (SignaledFence& fence : m_fences){
+        if (!fence.waitFor(A_SHORT_WHILE)) PRINT_ERROR("Waiting for previous execution expired")
+    }
+}
+void FlowQueueScheduler::destroy(){
+    waitAll();
+    m_main_allocator.destroy();
+    m_compute_allocator.destroy();
+}
+FlowQueue FlowQueueScheduler::getQueue(int p) const{
+    if (p < 0 || p >= (int) m_queues.size()) return FLOW_QUEUE_MAIN;
+    return m_queues[p];
+}
+void FlowQueueScheduler::acquire(const FlowQueueBatch& batch, CommandBuffer& buffer){
+    Queue& queue = (batch.queue == FLOW_QUEUE_MAIN) ? m_main_queue : m_compute_queue;
+    Queue& other = (batch.queue == FLOW_QUEUE_MAIN) ? m_compute_queue : m_main_queue;
+    BarrierBatch barriers;
+    for (const FlowSectionDescriptorUsage& d : batch.acquires){
+        int i = d.descriptor_index;
+        //the semaphore made all writes visible, barriers of the descriptor continue from the stages waiting for it.
+        //With different families the acquire barrier does the same layout transition as the release barrier on the other queue
+        if (d.isImage()){
+            PipelineImageState& state = m_context.getImageState(i);
+            if (m_transfer_ownership){
+                barriers.add(d.usage_stages, d.usage_stages, m_context.getImage(i).createMemoryBarrier(state, d.state.image, other.getFamilyIndex(), queue.getFamilyIndex()));
+                state = d.toImageState();
+            }else{
+                state.last_use = d.usage_stages;
+            }
+        }else{
+            PipelineBufferState& state = m_context.getBufferState(i);
+            if (m_transfer_ownership){
+                barriers.add(d.usage_stages, d.usage_stages, m_context.getBuffer(i).createMemoryBarrier(state.access, d.state.buffer.access, other.getFamilyIndex(), queue.getFamilyIndex()));
+                state = d.toBufferState();
+            }else{
+                state.last_use = d.usage_stages;
+            }
+        }
+    }
+    barriers.record(buffer);
+}
+void FlowQueueScheduler::release(const FlowQueueBatch& batch, CommandBuffer& buffer){
+    //only ownership has to be transferred, the semaphore orders the queues
+    if (!m_transfer_ownership) return;
+    Queue& queue = (batch.queue == FLOW_QUEUE_MAIN) ? m_main_queue : m_compute_queue;
+    Queue& other = (batch.queue == FLOW_QUEUE_MAIN) ? m_compute_queue : m_main_queue;
+    BarrierBatch barriers;
+    //states aren't updated, the matching acquire barrier starts from the same state
+    for (const FlowSectionDescriptorUsage& d : batch.releases){
+        int i = d.descriptor_index;
+        if (d.isImage()){
+            const PipelineImageState& state = m_context.getImageState(i);
+            barriers.add(state.last_use, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_context.getImage(i).createMemoryBarrier(state, d.state.image, queue.getFamilyIndex(), other.getFamilyIndex()));
+        }else{
+            const PipelineBufferState& state = m_context.getBufferState(i);
+            barriers.add(state.last_use, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_context.getBuffer(i).createMemoryBarrier(state.access, d.state.buffer.access, queue.getFamilyIndex(), other.getFamilyIndex()));
+        }
+    }
+    barriers.record(buffer);
+}
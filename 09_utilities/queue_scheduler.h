@@ -0,0 +1,127 @@
+#ifndef QUEUE_SCHEDULER_H
+#define QUEUE_SCHEDULER_H
+
+/**
+ * queue_scheduler.h
+ *  - FlowQueueScheduler, runs flow sections on a main and an async compute queue, so that independent compute work overlaps rendering
+ */
+
+
+#include "flow_sections.h"
+#include "../01_device/device.h"
+#include "../03_commands/synchronization.h"
+#include "../03_commands/transient_command_allocator.h"
+
+
+//The queue a section of FlowQueueScheduler runs on
+enum FlowQueue{
+    FLOW_QUEUE_MAIN,
+    FLOW_QUEUE_ASYNC_COMPUTE
+};
+
+
+/**
+ * FlowQueueBatch
+ *  - Consecutive sections of one queue that are recorded into one command buffer and submitted at once
+ */
+class FlowQueueBatch{
+public:
+    FlowQueue queue;
+    vector<FlowSection*> sections;
+    //descriptors coming from the other queue, acquired at the start of the batch. Usage holds the state and stages of the first use on this queue
+    vector<FlowSectionDescriptorUsage> acquires;
+    //descriptors handed over to the other queue, released at the end of the batch. Usage holds the state and stages of the first use on the other queue
+    vector<FlowSectionDescriptorUsage> releases;
+    //index of the batch of the other queue this one waits for, -1 if none, and the stages that wait
+    int wait_batch;
+    VkPipelineStageFlags wait_stages;
+    //batches of the other queue waiting for this one, each one has its' own semaphore
+    vector<uint32_t> signal_batches;
+    FlowQueueBatch(FlowQueue queue_);
+};
+
+
+/**
+ * FlowQueueScheduler
+ *  - Holds flow sections, each one tagged with the queue it runs on. Sections are given as pointers created with new, class is responsible for managing them
+ *  - The declaration order defines dependencies the same way as in FlowSectionList. When a descriptor is used on the other queue than the last time,
+ *    the sections are split into batches there, the batch using it waits for the previous one with a semaphore. If the queues are of different families,
+ *    ownership of the descriptor is transferred with a release barrier in the first batch and an acquire barrier in the second one
+ *  - Async compute sections that don't share descriptors with the main queue run while the main queue renders, e.g. particle simulation or light culling
+ *  - All descriptors are owned by the main queue before and after execution. The last batch on the main queue waits for all compute work
+ *  - Sections that transition during execution (section lists, render graphs) can use any descriptor, they run on the main queue only and wait for all
+ *    compute work declared before them. Ownership of descriptors they use is not transferred, with different queue families they must not share descriptors with async sections
+ *  - Descriptors are expected to use VK_SHARING_MODE_EXCLUSIVE. If both queues are the same, everything runs in one batch
+ */
+class FlowQueueScheduler{
+    //descriptor context associated with the sections
+    FlowDescriptorContext& m_context;
+    Queue& m_main_queue;
+    Queue& m_compute_queue;
+    //true if descriptors have to change owners between the queues
+    bool m_transfer_ownership;
+    //command buffers of each queue, reset once the frame that used them finishes
+    TransientCommandAllocator m_main_allocator;
+    TransientCommandAllocator m_compute_allocator;
+    //for each frame in flight, fence signaled when all batches finish, and one semaphore per batch waiting for the other queue
+    vector<SignaledFence> m_fences;
+    vector<vector<Semaphore>> m_semaphores;
+    uint32_t m_frame;
+
+    vector<unique_ptr<FlowSection>> m_sections;
+    vector<FlowQueue> m_queues;
+    //all batches in submission order, computed when completed
+    vector<FlowQueueBatch> m_batches;
+    bool m_completed;
+public:
+    /**
+     * Create an empty scheduler
+     * @param ctx flow descriptor context
+     * @param main_queue the queue for graphics work and sections that aren't tagged
+     * @param compute_queue the queue for async compute sections, may be the same as the main queue if the device has only one
+     * @param frames_in_flight how many executions can be in flight at once
+     */
+    FlowQueueScheduler(FlowDescriptorContext& ctx, Queue& main_queue, Queue& compute_queue, uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT);
+
+    /**
+     * Add a section to the end, can be done only before the scheduler is completed. Returns index of the section
+     * @param section pointer to the section created with new, the scheduler is responsible for deleting it
+     * @param queue the queue to run the section on
+     */
+    uint32_t addSection(FlowSection* section, FlowQueue queue = FLOW_QUEUE_MAIN);
+
+    /**
+     * Split sections into batches, then complete all sections
+     */
+    void complete();
+
+    /**
+     * Record all batches and submit them, batches of both queues are submitted in declaration order. Waits until the execution that used the same
+     * command buffers finished
+     * @param synchronization start semaphores are waited for by the first batch of the main queue, end semaphores are signaled by the last one, which finishes after
+     *                        all other batches. The end fence is signaled once all work finishes
+     */
+    void submit(const SubmitSynchronization& synchronization = SubmitSynchronization());
+
+    //Get number of batches submitted during each execution
+    uint32_t getBatchCount() const;
+
+    //Get the batches in submission order
+    const vector<FlowQueueBatch>& getBatches() const;
+
+    //Wait until all executions in flight finish
+    void waitAll();
+
+    //Wait for all executions, then destroy command pools
+    void destroy();
+private:
+    //Return the queue position p runs on, positions before the first section and after the last one belong to the main queue
+    FlowQueue getQueue(int p) const;
+    //Record acquire barriers of given batch, update descriptor states
+    void acquire(const FlowQueueBatch& batch, CommandBuffer& buffer);
+    //Record release barriers of given batch
+    void release(const FlowQueueBatch& batch, CommandBuffer& buffer);
+};
+
+
+#endif
@@ -0,0 +1,277 @@
+#include "render_graph.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+using std::map;
+using std::pair;
+using std::set;
+
+
+//identifies a descriptor in the descriptor context - whether it is an image, and its' index
+using DescriptorKey = pair<bool, int>;
+
+
+FlowRenderGraphPass::FlowRenderGraphPass(FlowSection* section_) : section(section_), enabled(true)
+{}
+
+
+
+uint32_t FlowRenderGraph::addPass(FlowSection* section){
+    if (m_compiled){
+        PRINT_ERROR("Passes can't be added to a completed render graph")
+        throw std::runtime_error("Passes can't be added to a completed render graph");
+    }
+    m_passes.push_back(FlowRenderGraphPass(section));
+    return m_passes.size() - 1;
+}
+FlowRenderGraph& FlowRenderGraph::setTransient(int image_index){
+    if (m_compiled){
+        PRINT_ERROR("Images can't be made transient after the render graph was completed")
+        return *this;
+    }
+    m_transient_images.push_back(image_index);
+    return *this;
+}
+FlowRenderGraph& FlowRenderGraph::setPassEnabled(uint32_t pass, bool enabled){
+    if (m_passes[pass].enabled != enabled){
+        m_passes[pass].enabled = enabled;
+        m_live_dirty = true;
+        invalidate();
+    }
+    return *this;
+}
+void FlowRenderGraph::complete(){
+    //transient memory is allocated only once, passes would be completed again
+    if (m_compiled){
+        PRINT_ERROR("Render graph is already completed")
+        return;
+    }
+    sortPasses();
+    //views of transient images are created when passes are completed, memory must be bound before that
+    allocateTransientImages();
+    for (FlowRenderGraphPass& pass : m_passes){
+        pass.section->complete();
+    }
+    m_compiled = true;
+    m_live_dirty = true;
+}
+void FlowRenderGraph::execute(CommandBuffer& buffer){
+    if (!m_compiled){
+        PRINT_ERROR("Render graph has to be completed before execution")
+        return;
+    }
+    if (m_live_dirty) cullPasses();
+    //contents of transient images don't survive between executions, their first use transitions them from the undefined layout.
+    //The barrier has to wait for the last use of the memory by all images sharing it, in this execution or the previous one
+    for (uint32_t i = 0; i < m_allocated_images.size(); i++){
+        m_context.getImageState(m_allocated_images[i]) = PipelineImageState(ImageState(IMAGE_NEWLY_CREATED), m_transient_wait_stages[i]);
+    }
+    //the first barrier of a transient image must stay after the last use of images aliasing it
+    runSectionsBatched(m_live_sections, buffer, m_context, [this](const FlowSection& a, const FlowSection& b){
+        return aliasesTransientMemory(a, b);
+    });
+}
+bool FlowRenderGraph::transitionsDuringExecute() const{
+    return true;
+}
+uint64_t FlowRenderGraph::getRecordVersion() const{
+    uint64_t version = FlowSection::getRecordVersion();
+    for (const FlowRenderGraphPass& pass : m_passes){
+        version += pass.section->getRecordVersion();
+    }
+    return version;
+}
+const vector<uint32_t>& FlowRenderGraph::getExecutionOrder(){
+    if (m_live_dirty) cullPasses();
+    return m_live_passes;
+}
+VkDeviceSize FlowRenderGraph::getTransientMemorySize() const{
+    return m_allocated_images.empty() ? 0 : m_transient_memory.getSize();
+}
+VkDeviceSize FlowRenderGraph::getUnaliasedTransientMemorySize() const{
+    return m_transient_memory.getUnaliasedSize();
+}
+void FlowRenderGraph::free(){
+    if (!m_allocated_images.empty()) m_transient_memory.free();
+}
+void FlowRenderGraph::sortPasses(){
+    uint32_t pass_count = m_passes.size();
+    //dependencies[i] - passes that have to run before pass i
+    vector<set<uint32_t>> dependencies(pass_count);
+    //last pass that wrote each descriptor, passes that read it since, and its' last layout
+    map<DescriptorKey, uint32_t> last_writer;
+    map<DescriptorKey, vector<uint32_t>> readers;
+    map<DescriptorKey, VkImageLayout> last_layout;
+    for (uint32_t p = 0; p < pass_count; p++){
+        FlowRenderGraphPass& pass = m_passes[p];
+        //sections that transition during execution may use any descriptor, nothing can be moved across them
+        if (pass.section->transitionsDuringExecute()){
+            for (uint32_t q = 0; q < p; q++) dependencies[p].insert(q);
+            for (uint32_t q = p + 1; q < pass_count; q++) dependencies[q].insert(p);
+        }
+        pass.writes.clear();
+        for (const FlowSectionDescriptorUsage& d : pass.section->getDescriptorUsages()){
+            DescriptorKey key{d.isImage(), d.descriptor_index};
+            //a layout transition modifies the image, so it is ordered like a write
+            bool write = isWriteAccess(d.isImage() ? d.state.image.access : d.state.buffer.access);
+            if (d.isImage()){
+                auto layout = last_layout.find(key);
+                if (layout != last_layout.end() && layout->second != d.state.image.layout) write = true;
+                last_layout[key] = d.state.image.layout;
+            }
+            pass.writes.push_back(write);
+            //read after write or write after write
+            auto writer = last_writer.find(key);
+            if (writer != last_writer.end() && writer->second != p) dependencies[p].insert(writer->second);
+            if (write){
+                //write after read
+                for (uint32_t r : readers[key]){
+                    if (r != p) dependencies[p].insert(r);
+                }
+                readers[key].clear();
+                last_writer[key] = p;
+            }else{
+                readers[key].push_back(p);
+            }
+        }
+    }
+
+    //topological sort. Of passes that can run, the first declared one that doesn't depend on the previous pass is picked, so that
+    //the barrier before a pass doesn't have to wait for work that was just submitted. If all depend on it, the first declared one is picked
+    m_order.clear();
+    vector<bool> scheduled(pass_count, false);
+    vector<uint32_t> remaining(pass_count);
+    for (uint32_t p = 0; p < pass_count; p++) remaining[p] = dependencies[p].size();
+    while (m_order.size() < pass_count){
+        int picked = -1;
+        for (uint32_t p = 0; p < pass_count; p++){
+            if (scheduled[p] || remaining[p] != 0) continue;
+            if (picked == -1) picked = p;
+            if (m_order.empty() || dependencies[p].count(m_order.back()) == 0){
+                picked = p;
+                break;
+            }
+        }
+        scheduled[picked] = true;
+        m_order.push_back(picked);
+        for (uint32_t p = 0; p < pass_count; p++){
+            if (dependencies[p].count(picked) != 0) remaining[p]--;
+        }
+    }
+}
+void FlowRenderGraph::allocateTransientImages(){
+    //first and last position of each transient image in the sorted order, and stages it was used in during its' last use
+    m_allocated_images.clear();
+    vector<VkPipelineStageFlags> last_stages;
+    for (int image : m_transient_images){
+        int first = -1, last = -1;
+        VkPipelineStageFlags stages = 0;
+        bool first_is_write = false;
+        for (uint32_t i = 0; i < m_order.size(); i++){
+            const FlowRenderGraphPass& pass = m_passes[m_order[i]];
+            const vector<FlowSectionDescriptorUsage>& usages = pass.section->getDescriptorUsages();
+            for (uint32_t u = 0; u < usages.size(); u++){
+                if (!usages[u].isImage() || usages[u].descriptor_index != image) continue;
+                if (first == -1){
+                    first = i;
+                    first_is_write = pass.writes[u];
+                }
+                if (last != (int) i) stages = 0;
+                last = i;
+                stages |= usages[u].usage_stages;
+            }
+        }
+        if (first == -1){
+            PRINT_WARN("Transient image " << image << " isn't used by any pass")
+            continue;
+        }
+        if (!first_is_write) PRINT_WARN("Transient image " << image << " is read before it is written, its' contents are undefined")
+        m_allocated_images.push_back(image);
+        last_stages.push_back(stages);
+        m_transient_memory.addImage(m_context.getImage(image), first, last);
+    }
+    m_transient_wait_stages.assign(m_allocated_images.size(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    m_transient_overlaps.assign(m_allocated_images.size(), vector<bool>(m_allocated_images.size(), false));
+    if (m_allocated_images.empty()) return;
+    m_transient_memory.allocate();
+
+    //an image has to wait for all images sharing its' memory, including itself. Images used before it in the same execution are obvious,
+    //the ones used after it and the image itself were last used by the previous execution, which may still be running on the GPU
+    for (uint32_t a = 0; a < m_allocated_images.size(); a++){
+        VkDeviceSize a_start = m_transient_memory.getOffset(a);
+        VkDeviceSize a_end = a_start + m_context.getImage(m_allocated_images[a]).getMemoryRequirements().size;
+        for (uint32_t b = 0; b < m_allocated_images.size(); b++){
+            VkDeviceSize b_start = m_transient_memory.getOffset(b);
+            VkDeviceSize b_end = b_start + m_context.getImage(m_allocated_images[b]).getMemoryRequirements().size;
+            if (a_start < b_end && b_start < a_end){
+                m_transient_wait_stages[a] |= last_stages[b];
+                m_transient_overlaps[a][b] = true;
+            }
+        }
+    }
+}
+void FlowRenderGraph::cullPasses(){
+    //go from the last pass to the first one, remember transient images read by running passes
+    set<int> needed;
+    vector<bool> live(m_passes.size(), false);
+    for (auto it = m_order.rbegin(); it != m_order.rend(); it++){
+        FlowRenderGraphPass& pass = m_passes[*it];
+        if (!pass.enabled) continue;
+        if (pass.section->transitionsDuringExecute()){
+            //may read any image
+            live[*it] = true;
+            needed.insert(m_transient_images.begin(), m_transient_images.end());
+            continue;
+        }
+        const vector<FlowSectionDescriptorUsage>& usages = pass.section->getDescriptorUsages();
+        //a pass is needed if it writes a non-transient descriptor or a needed transient image. Passes that write nothing can't be proven useless
+        bool writes_any = false, needed_write = false;
+        for (uint32_t u = 0; u < usages.size(); u++){
+            if (!pass.writes[u]) continue;
+            writes_any = true;
+            if (!isTransient(usages[u].isImage(), usages[u].descriptor_index) || needed.count(usages[u].descriptor_index) != 0) needed_write = true;
+        }
+        if (writes_any && !needed_write) continue;
+        live[*it] = true;
+        //written images are produced here, earlier contents aren't needed, unless the pass reads them too
+        for (uint32_t u = 0; u < usages.size(); u++){
+            if (pass.writes[u] && usages[u].isImage()) needed.erase(usages[u].descriptor_index);
+        }
+        for (uint32_t u = 0; u < usages.size(); u++){
+            if (usages[u].isImage() && isReadAccess(usages[u].state.image.access) && isTransient(true, usages[u].descriptor_index)) needed.insert(usages[u].descriptor_index);
+        }
+    }
+    m_live_passes.clear();
+    m_live_sections.clear();
+    for (uint32_t p : m_order){
+        if (!live[p]) continue;
+        m_live_passes.push_back(p);
+        m_live_sections.push_back(m_passes[p].section.get());
+    }
+    m_live_dirty = false;
+}
+bool FlowRenderGraph::isTransient(bool is_image, int descriptor_index) const{
+    return is_image && std::find(m_transient_images.begin(), m_transient_images.end(), descriptor_index) != m_transient_images.end();
+}
+bool FlowRenderGraph::aliasesTransientMemory(const FlowSection& a, const FlowSection& b) const{
+    //indices of allocated transient images used by each section
+    vector<uint32_t> images_a, images_b;
+    for (uint32_t i = 0; i < m_allocated_images.size(); i++){
+        for (const FlowSectionDescriptorUsage& usage : a.getDescriptorUsages()){
+            if (usage.isImage() && usage.descriptor_index == m_allocated_images[i]) images_a.push_back(i);
+        }
+        for (const FlowSectionDescriptorUsage& usage : b.getDescriptorUsages()){
+            if (usage.isImage() && usage.descriptor_index == m_allocated_images[i]) images_b.push_back(i);
+        }
+    }
+    //sections using the same image share a descriptor, sharesDescriptors() handles that case
+    for (uint32_t image_a : images_a){
+        for (uint32_t image_b : images_b){
+            if (image_a != image_b && m_transient_overlaps[image_a][image_b]) return true;
+        }
+    }
+    return false;
+}
+
+void FlowRenderGraph::addPasses(){}
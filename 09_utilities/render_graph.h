@@ -0,0 +1,144 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+/**
+ * render_graph.h
+ *  - FlowRenderGraph, a list of flow sections that is reordered, culled and given transient memory automatically
+ */
+
+
+#include "flow_sections.h"
+#include "../04_memory_objects/aliased_memory_object.h"
+
+
+/**
+ * FlowRenderGraphPass
+ *  - One section of the render graph and how it accesses its' descriptors
+ */
+class FlowRenderGraphPass{
+public:
+    unique_ptr<FlowSection> section;
+    //disabled passes are skipped, passes that only they depend on are culled
+    bool enabled;
+    //for each descriptor usage of the section, true if the usage writes the descriptor or changes its' layout
+    vector<bool> writes;
+    FlowRenderGraphPass(FlowSection* section_);
+};
+
+
+/**
+ * FlowRenderGraph
+ *  - Holds passes (flow sections), reads and writes of each pass are known from its' descriptor usages - usages with write access or a layout change write,
+ *    the rest read. The declaration order defines what each pass reads, e.g. a pass reads the result of the last pass declared before it that writes the descriptor
+ *  - When completed, passes are sorted topologically - dependent passes are separated by independent ones where possible, so that barriers stall less.
+ *    Transient images get memory shared by images that are never used at the same time
+ *  - During execution, passes whose results are never used are culled - a pass runs only if it writes a non-transient descriptor or a transient image
+ *    read by a later running pass. Barriers are batched and redundant ones skipped, see runSectionsBatched()
+ *  - The compiled order is cached, only the set of running passes is recomputed when passes are enabled or disabled
+ *  - Transient images have undefined contents at the start of each execution, they must be created without memory and written before they are read
+ */
+class FlowRenderGraph : public FlowSection{
+    //descriptor context associated with this graph
+    FlowDescriptorContext& m_context;
+    vector<FlowRenderGraphPass> m_passes;
+    //descriptor indices of transient images, and indices of those used by any pass
+    vector<int> m_transient_images;
+    vector<int> m_allocated_images;
+    AliasedMemoryObject m_transient_memory;
+    //for each allocated transient image, stages in which images sharing its' memory, including itself, were last used. Its' first barrier waits for them
+    vector<VkPipelineStageFlags> m_transient_wait_stages;
+    //for each pair of allocated transient images, true if their memory ranges overlap
+    vector<vector<bool>> m_transient_overlaps;
+    //all passes in execution order
+    vector<uint32_t> m_order;
+    //passes that will run, in execution order
+    vector<uint32_t> m_live_passes;
+    vector<FlowSection*> m_live_sections;
+    //true once the order is computed and transient memory allocated
+    bool m_compiled;
+    //true if the set of running passes has to be recomputed
+    bool m_live_dirty;
+public:
+    /**
+     * Initialize FlowRenderGraph with descriptor context and pointers to all passes, the graph is responsible for deleting them
+     * @param ctx flow descriptor context
+     * @param args any number of pointers to sections (base class must be FlowSection)
+     */
+    template<typename... Args>
+    FlowRenderGraph(FlowDescriptorContext& ctx, Args*... args) : FlowSection({}), m_context(ctx), m_compiled(false), m_live_dirty(true){
+        m_passes.reserve(sizeof...(args));
+        addPasses(args...);
+    }
+
+    /**
+     * Add a pass to the end of the graph, can be done only before the graph is completed. Returns index of the pass
+     * @param section pointer to the section created with new, the graph is responsible for deleting it
+     */
+    uint32_t addPass(FlowSection* section);
+
+    /**
+     * Mark an image of the descriptor context as transient - its' contents aren't needed outside the graph, so it can share memory with other transient images.
+     * The image must not have any memory bound.
+     * @param image_index index of the image in the descriptor context
+     */
+    FlowRenderGraph& setTransient(int image_index);
+
+    /**
+     * Enable or disable a pass, e.g. to toggle a post-processing effect. Passes whose results were used only by disabled passes are culled as well
+     * @param pass index of the pass, in the order the passes were added in
+     * @param enabled whether the pass should run
+     */
+    FlowRenderGraph& setPassEnabled(uint32_t pass, bool enabled);
+
+    /**
+     * Sort the passes, allocate memory for transient images, then complete all passes. Can be called only once
+     */
+    virtual void complete();
+
+    /**
+     * Run all passes that aren't culled in the compiled order
+     * @param command_buffer the buffer to record passes into
+     */
+    virtual void execute(CommandBuffer& command_buffer);
+
+    //Passes transition their descriptors during execute(), returns true
+    virtual bool transitionsDuringExecute() const;
+
+    //Sum of record versions of all passes, changes when passes are enabled or disabled too
+    virtual uint64_t getRecordVersion() const;
+
+    //Get indices of passes that will run, in execution order
+    const vector<uint32_t>& getExecutionOrder();
+
+    //Get size of memory used by transient images
+    VkDeviceSize getTransientMemorySize() const;
+
+    //Get size of memory transient images would need without sharing
+    VkDeviceSize getUnaliasedTransientMemorySize() const;
+
+    //Return memory of transient images to the allocator, the images may not be used by the device anymore
+    void free();
+private:
+    //Sort passes topologically, compute which usages write
+    void sortPasses();
+    //Place transient images into shared memory according to their lifetimes in the sorted order
+    void allocateTransientImages();
+    //Compute the set of running passes
+    void cullPasses();
+    //Return true if given descriptor is a transient image
+    bool isTransient(bool is_image, int descriptor_index) const;
+    //Return true if the sections use different transient images sharing memory, transitions of one can't be moved before the other
+    bool aliasesTransientMemory(const FlowSection& a, const FlowSection& b) const;
+
+    //is called when there are no more passes left to add, does nothing
+    void addPasses();
+    //Is called while there are passes still to add
+    template<typename T, typename... Args>
+    void addPasses(T* ptr, Args*... args){
+        addPass(ptr);
+        addPasses(args...);
+    }
+};
+
+
+#endif
@@ -0,0 +1,266 @@
+#include "virtual_texture.h"
+
+#include "../01_device/allocator.h"
+#include <algorithm>
+
+
+SparseBindBatch::SparseBindBatch() : m_images(), m_image_binds(), m_opaque_images(), m_opaque_binds()
+{}
+void SparseBindBatch::bindPage(VkImage image, const VkSparseImageMemoryBind& bind){
+    //find the image the bind belongs to, add it if it isn't in the batch yet
+    auto it = std::find(m_images.begin(), m_images.end(), image);
+    if (it == m_images.end()){
+        m_images.push_back(image);
+        m_image_binds.push_back(vector<VkSparseImageMemoryBind>());
+        it = m_images.end() - 1;
+    }
+    m_image_binds[it - m_images.begin()].push_back(bind);
+}
+void SparseBindBatch::bindOpaque(VkImage image, const VkSparseMemoryBind& bind){
+    auto it = std::find(m_opaque_images.begin(), m_opaque_images.end(), image);
+    if (it == m_opaque_images.end()){
+        m_opaque_images.push_back(image);
+        m_opaque_binds.push_back(vector<VkSparseMemoryBind>());
+        it = m_opaque_images.end() - 1;
+    }
+    m_opaque_binds[it - m_opaque_images.begin()].push_back(bind);
+}
+uint32_t SparseBindBatch::getBindCount() const{
+    uint32_t count = 0;
+    for (const vector<VkSparseImageMemoryBind>& binds : m_image_binds) count += binds.size();
+    for (const vector<VkSparseMemoryBind>& binds : m_opaque_binds) count += binds.size();
+    return count;
+}
+bool SparseBindBatch::empty() const{
+    return m_images.empty() && m_opaque_images.empty();
+}
+void SparseBindBatch::submit(Queue& queue, const SubmitSynchronization& synchronization){
+    if (empty()) return;
+    //one bind info for each image with page binds and one for each image with opaque binds
+    vector<VkSparseImageMemoryBindInfo> image_infos(m_images.size());
+    for (uint32_t i = 0; i < m_images.size(); i++){
+        image_infos[i] = VkSparseImageMemoryBindInfo{m_images[i], (uint32_t) m_image_binds[i].size(), m_image_binds[i].data()};
+    }
+    vector<VkSparseImageOpaqueMemoryBindInfo> opaque_infos(m_opaque_images.size());
+    for (uint32_t i = 0; i < m_opaque_images.size(); i++){
+        opaque_infos[i] = VkSparseImageOpaqueMemoryBindInfo{m_opaque_images[i], (uint32_t) m_opaque_binds[i].size(), m_opaque_binds[i].data()};
+    }
+    //all binds are submitted at once, batching them is much cheaper than one vkQueueBindSparse call per page
+    VkBindSparseInfo bind_info{VK_STRUCTURE_TYPE_BIND_SPARSE_INFO, nullptr,
+        synchronization.getStartSemaphoreCount(), synchronization.getStartSemaphores(),
+        0, nullptr,
+        (uint32_t) opaque_infos.size(), opaque_infos.data(),
+        (uint32_t) image_infos.size(), image_infos.data(),
+        synchronization.getEndSemaphoreCount(), synchronization.getEndSemaphores()};
+    VkResult result = vkQueueBindSparse(queue, 1, &bind_info, synchronization.getEndFence());
+    DEBUG_CHECK("Sparse memory binding", result)
+    m_images.clear();
+    m_image_binds.clear();
+    m_opaque_images.clear();
+    m_opaque_binds.clear();
+}
+
+
+
+VirtualTexturePage::VirtualTexturePage(uint32_t mip_level_, uint32_t array_layer_, VkOffset3D offset_, VkExtent3D extent_) :
+    mip_level(mip_level_), array_layer(array_layer_), offset(offset_), extent(extent_), memory(), last_used(0), requested(false)
+{}
+bool VirtualTexturePage::resident() const{
+    return memory.valid();
+}
+
+
+
+//return how many pages of given size are needed to cover given number of texels
+static uint32_t pagesToCover(uint32_t texels, uint32_t page_size){
+    return (texels + page_size - 1) / page_size;
+}
+
+VirtualTexture::VirtualTexture(const ImageInfo& info, VkDeviceSize memory_budget, SparseBindBatch& batch, const MemoryTypeRequest& request) :
+    m_image(ImageInfo(info).setSparse().createImage()), m_mip_tail_start(0), m_resident_count(0), m_update(0), m_request(request)
+{
+    //for sparse images, alignment is the size of one page in bytes
+    m_memory_requirements = m_image.getMemoryRequirements();
+    m_page_budget = (uint32_t) (memory_budget / m_memory_requirements.alignment);
+
+    uint32_t mip_levels = m_image.getMipLevels();
+    uint32_t layers = m_image.getArrayLayers();
+    m_mip_tail_start = mip_levels;
+    bool color_found = false;
+    for (const VkSparseImageMemoryRequirements& requirements : m_image.getSparseMemoryRequirements()){
+        bool metadata = (requirements.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT);
+        if (!metadata){
+            color_found = true;
+            m_page_size = requirements.formatProperties.imageGranularity;
+            m_mip_tail_start = std::min(requirements.imageMipTailFirstLod, mip_levels);
+        }
+        //the mip tail is either one for the whole image, or one per array layer. The metadata aspect consists of the mip tail only
+        if (requirements.imageMipTailFirstLod >= mip_levels && !metadata) continue;
+        bool single_tail = (requirements.formatProperties.flags & VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT);
+        uint32_t tail_count = single_tail ? 1 : layers;
+        for (uint32_t i = 0; i < tail_count; i++){
+            MemoryAllocation memory = g_allocator.get().allocateMemory(requirements.imageMipTailSize, m_memory_requirements.memoryTypeBits, request,
+                m_memory_requirements.alignment, MEMORY_RESOURCE_OPTIMAL);
+            m_opaque_memory.push_back(memory);
+            batch.bindOpaque(m_image, VkSparseMemoryBind{requirements.imageMipTailOffset + i * requirements.imageMipTailStride, requirements.imageMipTailSize,
+                memory.memory, memory.offset, metadata ? (VkSparseMemoryBindFlags) VK_SPARSE_MEMORY_BIND_METADATA_BIT : (VkSparseMemoryBindFlags) 0});
+        }
+    }
+    //without the color aspect there is no page size, the page table can't be built
+    if (!color_found){
+        PRINT_ERROR("Virtual texture format doesn't support sparse residency for color aspect")
+        throw std::runtime_error("Virtual texture format doesn't support sparse residency for color aspect");
+    }
+
+    //create the page table - all pages of mip level 0 for each layer, then all pages of level 1, and so on until the mip tail
+    const VkExtent3D& size = m_image.getSize();
+    for (uint32_t mip = 0; mip < m_mip_tail_start; mip++){
+        VkExtent3D mip_size{std::max(size.width >> mip, 1U), std::max(size.height >> mip, 1U), std::max(size.depth >> mip, 1U)};
+        VkExtent3D counts{pagesToCover(mip_size.width, m_page_size.width), pagesToCover(mip_size.height, m_page_size.height), pagesToCover(mip_size.depth, m_page_size.depth)};
+        m_mip_first_page.push_back(m_pages.size());
+        m_mip_page_counts.push_back(counts);
+        for (uint32_t layer = 0; layer < layers; layer++){
+            for (uint32_t z = 0; z < counts.depth; z++){
+                for (uint32_t y = 0; y < counts.height; y++){
+                    for (uint32_t x = 0; x < counts.width; x++){
+                        //pages on the edges are clipped to the mip size
+                        VkOffset3D offset{(int32_t) (x * m_page_size.width), (int32_t) (y * m_page_size.height), (int32_t) (z * m_page_size.depth)};
+                        VkExtent3D extent{std::min(m_page_size.width, mip_size.width - offset.x), std::min(m_page_size.height, mip_size.height - offset.y),
+                            std::min(m_page_size.depth, mip_size.depth - offset.z)};
+                        m_pages.push_back(VirtualTexturePage(mip, layer, offset, extent));
+                    }
+                }
+            }
+        }
+    }
+}
+void VirtualTexture::addFeedback(const uint32_t* feedback, uint32_t count){
+    count = std::min(count, getPageCount());
+    for (uint32_t i = 0; i < count; i++){
+        if (feedback[i] != 0) requestPage(i);
+    }
+}
+void VirtualTexture::requestPage(uint32_t page_index){
+    m_pages[page_index].requested = true;
+}
+void VirtualTexture::requestRegion(uint32_t mip_level, uint32_t array_layer, VkOffset3D offset, VkExtent3D extent){
+    //the mip tail is always resident
+    if (mip_level >= m_mip_tail_start) return;
+    if (extent.width == 0 || extent.height == 0 || extent.depth == 0) return;
+    const VkExtent3D& counts = m_mip_page_counts[mip_level];
+    //clip the region to the texture, parts before the first texel are dropped, nothing is requested if the whole region lies before it
+    int64_t start_x = std::max<int64_t>(offset.x, 0), start_y = std::max<int64_t>(offset.y, 0), start_z = std::max<int64_t>(offset.z, 0);
+    int64_t end_x = int64_t(offset.x) + extent.width, end_y = int64_t(offset.y) + extent.height, end_z = int64_t(offset.z) + extent.depth;
+    if (end_x <= 0 || end_y <= 0 || end_z <= 0) return;
+    //request all pages from the one containing the first texel to the one containing the last one, loops are empty if the region starts after the last page
+    uint32_t first_x = start_x / m_page_size.width, first_y = start_y / m_page_size.height, first_z = start_z / m_page_size.depth;
+    uint32_t last_x = std::min<int64_t>((end_x - 1) / m_page_size.width, counts.width - 1);
+    uint32_t last_y = std::min<int64_t>((end_y - 1) / m_page_size.height, counts.height - 1);
+    uint32_t last_z = std::min<int64_t>((end_z - 1) / m_page_size.depth, counts.depth - 1);
+    for (uint32_t z = first_z; z <= last_z; z++){
+        for (uint32_t y = first_y; y <= last_y; y++){
+            for (uint32_t x = first_x; x <= last_x; x++){
+                requestPage(getPageIndex(mip_level, array_layer, x, y, z));
+            }
+        }
+    }
+}
+vector<uint32_t> VirtualTexture::update(SparseBindBatch& batch){
+    m_update++;
+    //pages requested now that aren't resident yet, and resident pages that can be evicted
+    vector<uint32_t> missing;
+    vector<uint32_t> evictable;
+    for (uint32_t i = 0; i < m_pages.size(); i++){
+        VirtualTexturePage& page = m_pages[i];
+        if (page.requested){
+            page.last_used = m_update;
+            if (!page.resident()) missing.push_back(i);
+        }else if (page.resident()){
+            evictable.push_back(i);
+        }
+        page.requested = false;
+    }
+    //load coarse levels first, evict the least recently used pages first
+    std::stable_sort(missing.begin(), missing.end(), [this](uint32_t a, uint32_t b){
+        return m_pages[a].mip_level > m_pages[b].mip_level;
+    });
+    std::stable_sort(evictable.begin(), evictable.end(), [this](uint32_t a, uint32_t b){
+        return m_pages[a].last_used < m_pages[b].last_used;
+    });
+    vector<uint32_t> loaded;
+    uint32_t next_evicted = 0;
+    for (uint32_t page_index : missing){
+        if (m_resident_count >= m_page_budget){
+            //budget is full and all remaining resident pages are in use - the rest of the requests can't be satisfied
+            if (next_evicted == evictable.size()) break;
+            evict(evictable[next_evicted++], batch);
+        }
+        if (!makeResident(page_index, batch)) break;
+        loaded.push_back(page_index);
+    }
+    return loaded;
+}
+uint32_t VirtualTexture::getPageIndex(uint32_t mip_level, uint32_t array_layer, uint32_t x, uint32_t y, uint32_t z) const{
+    const VkExtent3D& counts = m_mip_page_counts[mip_level];
+    return m_mip_first_page[mip_level] + ((array_layer * counts.depth + z) * counts.height + y) * counts.width + x;
+}
+const VirtualTexturePage& VirtualTexture::getPage(uint32_t page_index) const{
+    return m_pages[page_index];
+}
+uint32_t VirtualTexture::getPageCount() const{
+    return m_pages.size();
+}
+const VkExtent3D& VirtualTexture::getPageSize() const{
+    return m_page_size;
+}
+VkDeviceSize VirtualTexture::getPageSizeInBytes() const{
+    return m_memory_requirements.alignment;
+}
+uint32_t VirtualTexture::getMipTailStart() const{
+    return m_mip_tail_start;
+}
+uint32_t VirtualTexture::getResidentPageCount() const{
+    return m_resident_count;
+}
+uint32_t VirtualTexture::getPageBudget() const{
+    return m_page_budget;
+}
+Image& VirtualTexture::getImage(){
+    return m_image;
+}
+void VirtualTexture::free(){
+    for (VirtualTexturePage& page : m_pages){
+        if (page.resident()) g_allocator.get().releaseMemory(page.memory);
+        page.memory = MemoryAllocation();
+    }
+    for (const MemoryAllocation& memory : m_opaque_memory){
+        g_allocator.get().releaseMemory(memory);
+    }
+    m_opaque_memory.clear();
+    m_resident_count = 0;
+    g_allocator.get().releaseImage(m_image);
+}
+bool VirtualTexture::makeResident(uint32_t page_index, SparseBindBatch& batch){
+    VirtualTexturePage& page = m_pages[page_index];
+    page.memory = g_allocator.get().allocateMemory(m_memory_requirements.alignment, m_memory_requirements.memoryTypeBits, m_request,
+        m_memory_requirements.alignment, MEMORY_RESOURCE_OPTIMAL);
+    if (!page.resident()){
+        PRINT_WARN("Couldn't allocate memory for virtual texture page")
+        return false;
+    }
+    batch.bindPage(m_image, getPageBind(page, page.memory));
+    m_resident_count++;
+    return true;
+}
+void VirtualTexture::evict(uint32_t page_index, SparseBindBatch& batch){
+    VirtualTexturePage& page = m_pages[page_index];
+    //binding null memory makes the page non-resident. The memory may still be read by frames in flight, it is released after the current frame finishes
+    batch.bindPage(m_image, getPageBind(page, MemoryAllocation()));
+    g_allocator.get().releaseMemory(page.memory);
+    page.memory = MemoryAllocation();
+    m_resident_count--;
+}
+VkSparseImageMemoryBind VirtualTexture::getPageBind(const VirtualTexturePage& page, const MemoryAllocation& memory) const{
+    VkImageSubresource subresource{m_image.getAspect(), page.mip_level, page.array_layer};
+    return VkSparseImageMemoryBind{subresource, page.offset, page.extent, memory.memory, memory.offset, 0};
+}
@@ -0,0 +1,188 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+/**
+ * virtual_texture.h
+ *  - Holds classes for partially resident (sparse) images, that keep only the pages that are actually sampled in memory
+ */
+
+
+#include "../00_base/vulkan_base.h"
+#include "../01_device/device.h"
+#include "../01_device/memory_block.h"
+#include "../03_commands/synchronization.h"
+#include "../04_memory_objects/image.h"
+#include "../04_memory_objects/image_info.h"
+
+
+/**
+ * SparseBindBatch
+ *  - Collects sparse memory binds of any number of images, then submits all of them with one vkQueueBindSparse call
+ */
+class SparseBindBatch{
+    //images with page binds, and the binds of each of them
+    vector<VkImage> m_images;
+    vector<vector<VkSparseImageMemoryBind>> m_image_binds;
+    //images with opaque binds (mip tails, metadata), and the binds of each of them
+    vector<VkImage> m_opaque_images;
+    vector<vector<VkSparseMemoryBind>> m_opaque_binds;
+public:
+    SparseBindBatch();
+
+    /**
+     * Bind memory to one page of an image, or unbind it if bind.memory is VK_NULL_HANDLE
+     * @param image the sparse image
+     * @param bind the page and memory to bind
+     */
+    void bindPage(VkImage image, const VkSparseImageMemoryBind& bind);
+
+    /**
+     * Bind memory to a range of the opaque image memory, e.g. the mip tail
+     * @param image the sparse image
+     * @param bind the range and memory to bind
+     */
+    void bindOpaque(VkImage image, const VkSparseMemoryBind& bind);
+
+    //Return the number of binds waiting for submission
+    uint32_t getBindCount() const;
+    bool empty() const;
+
+    /**
+     * Submit all binds to the queue, then clear the batch. Does nothing if the batch is empty.
+     * Sparse binding doesn't wait at any pipeline stage, start semaphore stage flags are ignored.
+     * @param queue the queue to bind on, it has to be from a family that supports VK_QUEUE_SPARSE_BINDING_BIT
+     * @param synchronization semaphores to wait for and to signal, and the fence to signal when binding finishes
+     */
+    void submit(Queue& queue, const SubmitSynchronization& synchronization = SubmitSynchronization());
+};
+
+
+/**
+ * VirtualTexturePage
+ *  - One entry of the page table of a virtual texture
+ */
+class VirtualTexturePage{
+public:
+    uint32_t mip_level;
+    uint32_t array_layer;
+    //first texel and size of the page in texels. Pages on the edges of the image may be smaller than the page size
+    VkOffset3D offset;
+    VkExtent3D extent;
+    //memory bound to the page, invalid if the page isn't resident
+    MemoryAllocation memory;
+    //the last update the page was requested in
+    uint64_t last_used;
+    //whether the page was requested since the last update
+    bool requested;
+
+    VirtualTexturePage(uint32_t mip_level_, uint32_t array_layer_, VkOffset3D offset_, VkExtent3D extent_);
+
+    //return memory.valid()
+    bool resident() const;
+};
+
+
+/**
+ * VirtualTexture
+ *  - A sparse image together with a page table and a residency manager. Only a fixed number of pages can be resident at once,
+ *    which lets huge terrain or volume textures be used with a fixed memory budget.
+ *  - Every frame, the application reports which pages were sampled - either by reading back a feedback buffer with one value per page,
+ *    or by requesting regions directly. update() then makes the requested pages resident, evicting the least recently used ones if the budget is exceeded,
+ *    and returns the pages whose contents have to be uploaded.
+ *  - Mip levels smaller than one page (the mip tail) are always resident. Other pages read as undefined (zero if residencyNonResidentStrict) until they are uploaded,
+ *    shaders should sample with sparseTextureARB / clamp to the resident levels.
+ *  - Only color images are supported, the image can't be aliased or shared between queue families.
+ */
+class VirtualTexture{
+    Image m_image;
+    //memory type bits, page size and alignment in bytes
+    VkMemoryRequirements m_memory_requirements;
+    //page size in texels
+    VkExtent3D m_page_size;
+    //the first mip level in the mip tail
+    uint32_t m_mip_tail_start;
+    //index of the first page of each mip level in the page table, and page counts in each dimension per mip level
+    vector<uint32_t> m_mip_first_page;
+    vector<VkExtent3D> m_mip_page_counts;
+    vector<VirtualTexturePage> m_pages;
+    //memory of all mip tails and metadata, bound for the whole life of the texture
+    vector<MemoryAllocation> m_opaque_memory;
+    //maximum number of resident pages
+    uint32_t m_page_budget;
+    uint32_t m_resident_count;
+    //number of updates so far
+    uint64_t m_update;
+    MemoryTypeRequest m_request;
+public:
+    /**
+     * Create a virtual texture. Mip tails are bound into the batch given, it has to be submitted before the texture is used.
+     * @param info image info, sparse flags are added automatically
+     * @param memory_budget maximum number of bytes resident pages can occupy, mip tails aren't counted
+     * @param batch batch to record mip tail binds into
+     * @param request memory type request for the pages
+     */
+    VirtualTexture(const ImageInfo& info, VkDeviceSize memory_budget, SparseBindBatch& batch,
+        const MemoryTypeRequest& request = MemoryTypeRequest(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, MEMORY_USAGE_GPU_ONLY));
+
+    /**
+     * Report which pages were sampled, e.g. from a feedback buffer read back from the GPU
+     * @param feedback one value per page, in page table order (see getPageIndex), a non-zero value marks a sampled page
+     * @param count number of values, at most getPageCount()
+     */
+    void addFeedback(const uint32_t* feedback, uint32_t count);
+
+    //Request one page by its' index
+    void requestPage(uint32_t page_index);
+
+    /**
+     * Request all pages that overlap given region of a mip level, e.g. the terrain around the camera
+     * @param mip_level the mip level
+     * @param array_layer the array layer
+     * @param offset the first texel of the region, may be negative or outside the mip level, the region is clipped to it
+     * @param extent size of the region in texels, nothing is requested if it is empty
+     */
+    void requestRegion(uint32_t mip_level, uint32_t array_layer, VkOffset3D offset, VkExtent3D extent);
+
+    /**
+     * Make requested pages resident, evicting the least recently used pages that weren't requested during this update when the budget is full.
+     * Coarser mip levels are loaded first, so sampling falls back to them when the budget runs out. Evicted memory is released after the current frame.
+     * Returns indices of pages that were made resident, their contents have to be uploaded (e.g. using cmdCopyToTextureRegion) after the batch is submitted.
+     * @param batch batch to record page binds into
+     */
+    vector<uint32_t> update(SparseBindBatch& batch);
+
+    /**
+     * Get index of a page in the page table
+     * @param mip_level mip level of the page, it has to be smaller than getMipTailStart()
+     * @param array_layer array layer of the page
+     * @param x, y, z page coordinates - texel coordinates divided by page size
+     */
+    uint32_t getPageIndex(uint32_t mip_level, uint32_t array_layer, uint32_t x, uint32_t y = 0, uint32_t z = 0) const;
+
+    const VirtualTexturePage& getPage(uint32_t page_index) const;
+    uint32_t getPageCount() const;
+    //Get page size in texels
+    const VkExtent3D& getPageSize() const;
+    //Get page size in bytes
+    VkDeviceSize getPageSizeInBytes() const;
+    //Get the first mip level stored in the mip tail, levels from this one on are always resident
+    uint32_t getMipTailStart() const;
+    uint32_t getResidentPageCount() const;
+    uint32_t getPageBudget() const;
+    Image& getImage();
+
+    //Release memory of all pages and mip tails after the current frame, then destroy the image. The texture must not be used afterwards
+    void free();
+private:
+    //Bind memory to a page, return false if no memory could be allocated
+    bool makeResident(uint32_t page_index, SparseBindBatch& batch);
+
+    //Unbind page memory and release it after the current frame
+    void evict(uint32_t page_index, SparseBindBatch& batch);
+
+    //Create sparse image bind structure for a page
+    VkSparseImageMemoryBind getPageBind(const VirtualTexturePage& page, const MemoryAllocation& memory) const;
+};
+
+
+#endif
@@ -6,23 +6,32 @@
 
 #include "01_device/vulkan_instance.h"
 #include "01_device/allocator.h"
+#include "01_device/memory_block.h"
 #include "01_device/physical_device.h"
 #include "01_device/device.h"
 
+#include "02_swapchain/frame_pacer.h"
 #include "02_swapchain/swapchain.h"
 #include "02_swapchain/swapchain_info.h"
 #include "02_swapchain/window.h"
 
+#include "03_commands/barrier_batch.h"
 #include "03_commands/command_pool.h"
 #include "03_commands/synchronization.h"
+#include "03_commands/transient_command_allocator.h"
 #include "03_commands/command_buffer.h"
+#include "03_commands/frame_context.h"
+#include "03_commands/parallel_recorder.h"
 
+#include "04_memory_objects/aliased_memory_object.h"
 #include "04_memory_objects/buffer.h"
 #include "04_memory_objects/buffer_info.h"
 #include "04_memory_objects/image.h"
 #include "04_memory_objects/image_info.h"
 #include "04_memory_objects/local_object_creator.h"
+#include "04_memory_objects/local_object_reader.h"
 #include "04_memory_objects/mixed_buffer.h"
+#include "04_memory_objects/uniform_ring_buffer.h"
 
 #include "05_descriptor_sets/sampler.h"
 #include "05_descriptor_sets/descriptor_pool.h"
@@ -52,3 +61,8 @@
 #include "09_utilities/image_load.h"
 #include "09_utilities/flow_sections_base.h"
 #include "09_utilities/flow_sections.h"
+#include "09_utilities/memory_compactor.h"
+#include "09_utilities/offscreen_swapchain.h"
+#include "09_utilities/render_graph.h"
+#include "09_utilities/queue_scheduler.h"
+#include "09_utilities/virtual_texture.h"